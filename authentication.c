@@ -2,161 +2,360 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <limits.h>
+#include <stddef.h>
+#include <unistd.h>
 #include <curl/curl.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
 #include "authentication.h"
-
+#include "string_arena.h"
+#include "perfect_hash.h"
+#include "string_sort.h"
+#include "mail_dispatch.h"
+#include "timer_wheel.h"
+
+#define MAIL_API_URL "https://marleyfetch.com/api/send"
+#define VERIFICATION_SUBJECT "Verification Code"
 #define AUTH_TOKEN "gmailer_14134ff48f211bc6295a6cd6054351223907b405a247fb7faeb53a09bc999043"
 
-static Student student_list[NUM_STUDENTS_MAX];
-static int student_count = 0;
+#define MIN_STUDENT_CAPACITY 64
+#define CODE_TTL_SECONDS 300
+#define MAX_CODE_ATTEMPTS 3
+#define PENDING_BLOCK_ENTRIES 4096
 
-static void generate_verification_code(char code_buf[8]) {
-    int code = rand() % 900000 + 100000;  // 100000–999999
-    snprintf(code_buf, 8, "%06d", code); 
+// the roster is kept as parallel arrays indexed by student: lookups touch only
+// the packed ID pool, and the issued flags of 64 students share one word
+static int student_count = 0;
+static int student_capacity = 0;
+static uint32_t *id_offset = NULL;  // into id_pool
+static char *id_pool = NULL;        // NUL-terminated IDs, in roster order once sorted
+static size_t id_pool_used = 0, id_pool_cap = 0;
+static const char **email = NULL;   // interned in email_strings
+static StringArena *email_strings = NULL;
+static uint64_t *issued_bits = NULL;
+static int issued_count = 0;        // updated atomically, so "all issued" is O(1)
+
+static MailDispatcher *mailer = NULL;
+
+static PerfectHash *id_index = NULL;
+static uint32_t *id_index_student = NULL;  // perfect hash slot -> student
+
+// one outstanding verification code per student. entries come from fixed blocks
+// so their timer nodes never move, and expiry is a tick of the wheel rather
+// than a scan; the table is only touched from the main thread
+typedef struct PendingCode {
+    TimerNode timer;  // expires at the code's deadline, in seconds since the epoch
+    struct PendingCode *next_free;
+    int student;
+    int attempts;
+    char code[AUTH_CODE_SIZE];
+} PendingCode;
+
+static PendingCode **pending = NULL;  // by student, NULL when no code is outstanding
+static PendingCode *pending_free = NULL;
+static PendingCode **pending_blocks = NULL;
+static size_t pending_block_count = 0;
+static TimerWheel code_timers;
+
+// uniform in 100000–999999, drawn from the seeded CSPRNG rather than rand()
+static int generate_verification_code(char code_buf[AUTH_CODE_SIZE]) {
+    uint32_t r;
+    do {
+        if (RAND_bytes((unsigned char *)&r, sizeof(r)) != 1) return 0;
+    } while (r >= UINT32_MAX - UINT32_MAX % 900000);
+    snprintf(code_buf, AUTH_CODE_SIZE, "%06u", (unsigned)(r % 900000 + 100000));
+    return 1;
 }
 
-int send_email_via_marleyfetch(const char *auth_token, const char *to, const char *subject, const char *text_body) {
-    CURL *curl = NULL;
-    CURLcode res;
-    int status = -1;
-
-    curl = curl_easy_init();
-    if (!curl) {
-        fprintf(stderr, "Failed to initialize CURL\n");
-        return -1;
+static PendingCode *pending_alloc(void) {
+    if (!pending_free) {
+        PendingCode **blocks = realloc(pending_blocks, (pending_block_count + 1) * sizeof(*blocks));
+        if (!blocks) return NULL;
+        pending_blocks = blocks;
+        PendingCode *block = calloc(PENDING_BLOCK_ENTRIES, sizeof(*block));
+        if (!block) return NULL;
+        pending_blocks[pending_block_count++] = block;
+        for (size_t i = PENDING_BLOCK_ENTRIES; i > 0; i--) {
+            block[i - 1].next_free = pending_free;
+            pending_free = &block[i - 1];
+        }
     }
+    PendingCode *p = pending_free;
+    pending_free = p->next_free;
+    return p;
+}
 
-    char json_data[2048];
-    snprintf(json_data, sizeof(json_data),
-             "{"
-             "\"to\":\"%s\","
-             "\"subject\":\"%s\","
-             "\"text_body\":\"%s\""
-             "}",
-             to, subject, text_body);
-
-    curl_easy_setopt(curl, CURLOPT_URL, "https://marleyfetch.com/api/send");
+static void pending_drop(PendingCode *p) {
+    timer_wheel_remove(&code_timers, &p->timer);
+    pending[p->student] = NULL;
+    p->next_free = pending_free;
+    pending_free = p;
+}
 
-    struct curl_slist *headers = NULL;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
+static void pending_reset(void) {
+    for (size_t i = 0; i < pending_block_count; i++) free(pending_blocks[i]);
+    free(pending_blocks);
+    free(pending);
+    pending_blocks = NULL;
+    pending_block_count = 0;
+    pending_free = NULL;
+    pending = student_count > 0 ? calloc((size_t)student_count, sizeof(*pending)) : NULL;
+    if (student_count > 0 && !pending) fprintf(stderr, "Warning: out of memory for verification codes\n");
+    timer_wheel_init(&code_timers, (uint64_t)time(NULL));
+}
 
-    char auth_header[1024];
-    snprintf(auth_header, sizeof(auth_header),
-             "Authorization: Bearer %s", auth_token);
+// replaces any code the student still has outstanding
+static int pending_store(int s, const char code[AUTH_CODE_SIZE]) {
+    if (!pending) return 0;
+    PendingCode *p = pending[s];
+    if (!p) {
+        p = pending_alloc();
+        if (!p) return 0;
+        p->timer = (TimerNode){ NULL, NULL, 0 };
+        p->student = s;
+        pending[s] = p;
+    }
+    p->attempts = 0;
+    memcpy(p->code, code, AUTH_CODE_SIZE);
+    timer_wheel_add(&code_timers, &p->timer, (uint64_t)time(NULL) + CODE_TTL_SECONDS);
+    return 1;
+}
 
-    headers = curl_slist_append(headers, auth_header);
+static void code_expired(TimerNode *node, void *arg) {
+    (void)arg;
+    pending_drop((PendingCode *)((char *)node - offsetof(PendingCode, timer)));
+}
 
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+void auth_expire_codes(time_t now) {
+    if (now > 0) timer_wheel_advance(&code_timers, (uint64_t)now, code_expired, NULL);
+}
 
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_data);
+size_t auth_pending_codes(void) {
+    return code_timers.count;
+}
 
-    res = curl_easy_perform(curl);
-    if (res == CURLE_OK) {
-        long response_code;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-        printf("HTTP Response Code: %ld\n", response_code);
+AuthCodeResult auth_check_code(int student, const char *code, size_t len) {
+    if (student < 0 || student >= student_count || !pending || !pending[student]) return AUTH_CODE_NONE;
+    PendingCode *p = pending[student];
 
-        if (response_code == 200 || response_code == 202) {
-            status = 0;
-        }
-    } else {
-        fprintf(stderr, "curl_easy_perform() failed: %s\n",
-                curl_easy_strerror(res));
+    // the wheel may not have ticked yet, so the deadline is checked here too
+    if ((uint64_t)time(NULL) >= p->timer.expires) {
+        pending_drop(p);
+        return AUTH_CODE_EXPIRED;
+    }
+    if (len == strlen(p->code) && CRYPTO_memcmp(code, p->code, len) == 0) {
+        pending_drop(p);
+        return AUTH_CODE_OK;
     }
+    if (++p->attempts >= MAX_CODE_ATTEMPTS) {
+        pending_drop(p);
+        return AUTH_CODE_LOCKED;
+    }
+    return AUTH_CODE_WRONG;
+}
 
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+// MAIL_API_URL / MAIL_API_TOKEN in the environment point the dispatcher at a local stand-in
+int auth_mail_start(void) {
+    if (mailer) return 1;
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        fprintf(stderr, "Failed to initialize CURL\n");
+        return 0;
+    }
+    const char *url = getenv("MAIL_API_URL");
+    const char *token = getenv("MAIL_API_TOKEN");
+    mailer = mail_dispatcher_start(url && *url ? url : MAIL_API_URL, token && *token ? token : AUTH_TOKEN);
+    return mailer != NULL;
+}
 
-    return status;
+void auth_mail_stop(void) {
+    mail_dispatcher_stop(mailer);
+    mailer = NULL;
 }
 
-// returns 0 on success, 1 on verification fail (no id, no mail, wrong mail, wrong code entered), 2 if token has already been generated
-int auth_email_verify(const char *student_id) {
-    if (!student_id) {
-        return 1; 
+// looks the student up and picks a code; returns the student index, or -1 / -2 like auth_send_code's 1 / 2
+static int prepare_code(const char *student_id, char code_out[AUTH_CODE_SIZE]) {
+    if (!student_id || !code_out) {
+        return -1;
     }
 
-    Student *s = auth_find_student(student_id);
-    if (!s) {
+    int s = auth_find_student(student_id);
+    if (s < 0) {
         printf("Unknown student ID: %s\n\n", student_id);
-        return 1;
+        return -1;
     }
 
-    if (s->token_generated) {
+    if (auth_token_generated(s)) {
         printf("Token for student ID %s has already been generated earlier.\n\n",
                student_id);
-        return 2;
+        return -2;
     }
 
-    if (!s->email || s->email[0] == '\0') {
+    if (!email[s] || email[s][0] == '\0') {
         printf("Internal error: no email stored for student ID %s\n\n", student_id);
-        return 1; 
+        return -1;
     }
 
-    char verification_code[8];
-    generate_verification_code(verification_code);
+    if (!mailer && !auth_mail_start()) return -1;
 
-    const char *subject = "Verification Code";
-    char body[256];
-    snprintf(body, sizeof(body),
-             "Your verification code is: %s",
-             verification_code);
+    if (!generate_verification_code(code_out) || !pending_store(s, code_out)) {
+        printf("Internal error: could not create a verification code for student ID %s\n\n", student_id);
+        return -1;
+    }
+    printf("Sending verification code to %s...\n", email[s]);
+    return s;
+}
 
-    printf("Sending verification code to %s...\n", s->email);
+static void code_body(char body[64], const char code[AUTH_CODE_SIZE]) {
+    snprintf(body, 64, "Your verification code is: %s", code);
+}
 
-    int email_status = send_email_via_marleyfetch(
-        AUTH_TOKEN,
-        s->email,
-        subject,
-        body
-    );
+int auth_send_code_async(const char *student_id, void (*done)(void *arg, int status), void *arg) {
+    char code[AUTH_CODE_SIZE];
+    int s = prepare_code(student_id, code);
+    if (s < 0) return s == -2 ? 2 : 1;
+
+    char body[64];
+    code_body(body, code);
+    if (!mail_dispatcher_submit(mailer, email[s], VERIFICATION_SUBJECT, body, done, arg)) {
+        pending_drop(pending[s]);
+        printf("Failed to send verification email. Please contact the administrator.\n\n");
+        return 1;
+    }
+    return 0;
+}
+
+// returns 0 when the code was sent, 1 on fail (no id, no mail, send error), 2 if token has already been generated
+int auth_send_code(const char *student_id) {
+    char code[AUTH_CODE_SIZE];
+    int s = prepare_code(student_id, code);
+    if (s < 0) return s == -2 ? 2 : 1;
+
+    char body[64];
+    code_body(body, code);
+    int email_status = mail_dispatcher_send(mailer, email[s], VERIFICATION_SUBJECT, body);
 
     if (email_status != 0) {
+        if (pending[s]) pending_drop(pending[s]);
         printf("Failed to send verification email. Please contact the administrator.\n\n");
         return 1;
     }
 
     printf("Verification code sent. Please check your AUA email.\n");
+    return 0;
+}
 
+// prompts for the code on stdin until it matches the student's outstanding code
+// or the attempts run out; returns 0 on a match, 1 otherwise
+int auth_prompt_code(const char *student_id) {
+    int student = auth_find_student(student_id);
     char code_input[64];
-    printf("Enter the 6-digit verification code: ");
-    fflush(stdout);
+    AuthCodeResult result = AUTH_CODE_WRONG;
+    while (result == AUTH_CODE_WRONG) {
+        printf("Enter the 6-digit verification code: ");
+        fflush(stdout);
+
+        if (!fgets(code_input, sizeof(code_input), stdin)) {
+            printf("\nInput error. Aborting this registration attempt.\n\n");
+            return 1;
+        }
+        size_t len = strlen(code_input);
+        if (len > 0 && (code_input[len - 1] == '\n' || code_input[len - 1] == '\r')) {
+            code_input[--len] = '\0';
+        }
 
-    if (!fgets(code_input, sizeof(code_input), stdin)) {
-        printf("\nInput error. Aborting this registration attempt.\n\n");
-        return 1;
+        result = auth_check_code(student, code_input, len);
+        if (result == AUTH_CODE_WRONG) {
+            printf("Wrong verification code, please try again.\n");
+        } else if (result == AUTH_CODE_EXPIRED || result == AUTH_CODE_NONE) {
+            printf("Verification code expired. Please request a new one.\n");
+        } else if (result == AUTH_CODE_LOCKED) {
+            printf("Too many wrong codes. Please request a new one.\n");
+        }
     }
-    size_t len = strlen(code_input);
-    if (len > 0 && (code_input[len - 1] == '\n' || code_input[len - 1] == '\r')) {
-        code_input[len - 1] = '\0';
+    return result == AUTH_CODE_OK ? 0 : 1;
+}
+
+// returns 0 on success, 1 on verification fail (no id, no mail, wrong mail, wrong code entered), 2 if token has already been generated
+int auth_email_verify(const char *student_id) {
+    int rc = auth_send_code(student_id);
+    if (rc != 0) {
+        return rc;
     }
+    return auth_prompt_code(student_id);
+}
 
-    if (strcmp(code_input, verification_code) != 0) {
-        return 1; 
+static int grow_roster(void) {
+    if (student_capacity > INT_MAX / 2) return 0;
+    int capacity = student_capacity ? student_capacity * 2 : MIN_STUDENT_CAPACITY;
+
+    uint32_t *offsets = realloc(id_offset, (size_t)capacity * sizeof(*offsets));
+    if (!offsets) return 0;
+    id_offset = offsets;
+    const char **emails = realloc(email, (size_t)capacity * sizeof(*emails));
+    if (!emails) return 0;
+    email = emails;
+
+    size_t old_words = (size_t)student_capacity / 64 + 1, words = (size_t)capacity / 64 + 1;
+    uint64_t *bits = realloc(issued_bits, words * sizeof(*bits));
+    if (!bits) return 0;
+    memset(bits + (student_capacity ? old_words : 0), 0,
+           (words - (student_capacity ? old_words : 0)) * sizeof(*bits));
+    issued_bits = bits;
+
+    student_capacity = capacity;
+    return 1;
+}
+
+static int append_id(const char *id, size_t len) {
+    if (id_pool_used + len + 1 > UINT32_MAX) return 0;
+    if (id_pool_used + len + 1 > id_pool_cap) {
+        size_t cap = id_pool_cap ? id_pool_cap * 2 : 4096;
+        while (cap < id_pool_used + len + 1) cap *= 2;
+        char *pool = realloc(id_pool, cap);
+        if (!pool) return 0;
+        id_pool = pool;
+        id_pool_cap = cap;
     }
-    return 0;
+    id_offset[student_count] = (uint32_t)id_pool_used;
+    memcpy(id_pool + id_pool_used, id, len + 1);
+    id_pool_used += len + 1;
+    return 1;
 }
 
 int auth_add_student(const char *this_id, const char *this_email) {
-    if (student_count >= NUM_STUDENTS_MAX) {
-        fprintf(stderr, "Error: Student list is full\n");
+    if (this_id == NULL) {
+        fprintf(stderr, "Error: ID cannot be NULL\n");
         return 1;
     }
 
-    if (this_id == NULL) {
-        fprintf(stderr, "Error: ID cannot be NULL\n");
+    size_t id_len = strlen(this_id);
+    if (id_len == 0 || id_len >= ID_SIZE) {
+        fprintf(stderr, "Error: ID must be 1 to %d characters\n", ID_SIZE - 1);
         return 1;
     }
 
-    if (this_email == NULL) {
-        student_list[student_count].email = NULL;
-    } else {
-        student_list[student_count].email = (char *)this_email;
+    if (!email_strings) {
+        email_strings = string_arena_create(0);
+        if (!email_strings) {
+            fprintf(stderr, "Error: Out of memory for the student list\n");
+            return -1;
+        }
     }
 
-    strncpy(student_list[student_count].id, this_id, ID_SIZE - 1);
-    student_list[student_count].id[ID_SIZE - 1] = '\0';
-    student_list[student_count].token_generated = false;
+    if (student_count == student_capacity && !grow_roster()) {
+        fprintf(stderr, "Error: Student list is full\n");
+        return -1;
+    }
+
+    // shared mailboxes are common in imported rosters, so emails are stored once
+    const char *mail = this_email ? string_arena_intern(email_strings, this_email, strlen(this_email)) : NULL;
+    if ((this_email && !mail) || !append_id(this_id, id_len)) {
+        fprintf(stderr, "Error: Out of memory for the student list\n");
+        return -1;
+    }
+    email[student_count] = mail;
 
     student_count++;
     return 0;
@@ -166,51 +365,126 @@ int auth_get_student_count(void) {
     return student_count;
 }
 
-static void swap_students(Student *a, Student *b) {
-    Student temp = *a;
-    *a = *b;
-    *b = temp;
+static uint64_t id_hash(const char *id) {
+    uint64_t h = 1469598103934665603ULL;
+    for (const unsigned char *p = (const unsigned char *)id; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 32;
+    h *= 0xd6e8feb86659fd93ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+static int compare_students(const void *a, const void *b) {
+    return strcmp(id_pool + id_offset[*(const uint32_t *)a], id_pool + id_offset[*(const uint32_t *)b]);
 }
 
-static int partition(Student arr[], int low, int high) {
-    const char *pivot = arr[high].id;
-    int i = low - 1;
+// repacks the pool in sorted order, dropping repeated IDs
+static int apply_order(const uint32_t *order) {
+    size_t pool_cap = id_pool_used ? id_pool_used : 1;
+    char *pool = malloc(pool_cap);
+    uint32_t *offsets = malloc((size_t)student_capacity * sizeof(*offsets));
+    const char **emails = malloc((size_t)student_capacity * sizeof(*emails));
+    if (!pool || !offsets || !emails) {
+        free(pool);
+        free(offsets);
+        free(emails);
+        return 0;
+    }
 
-    for (int j = low; j < high; j++) {
-        if (strcmp(arr[j].id, pivot) <= 0) {
-            i++;
-            swap_students(&arr[i], &arr[j]);
+    size_t used = 0;
+    int count = 0;
+    for (int i = 0; i < student_count; i++) {
+        const char *id = id_pool + id_offset[order[i]];
+        if (count > 0 && strcmp(id, pool + offsets[count - 1]) == 0) {
+            fprintf(stderr, "Warning: duplicate student ID %s ignored\n", id);
+            continue;
         }
+        size_t len = strlen(id) + 1;
+        memcpy(pool + used, id, len);
+        offsets[count] = (uint32_t)used;
+        emails[count] = email[order[i]];
+        used += len;
+        count++;
     }
-    swap_students(&arr[i + 1], &arr[high]);
-    return i + 1;
+
+    free(id_pool);
+    free(id_offset);
+    free(email);
+    id_pool = pool;
+    id_pool_cap = pool_cap;
+    id_pool_used = used;
+    id_offset = offsets;
+    email = emails;
+    student_count = count;
+    return 1;
 }
 
-static void quicksort_students(Student arr[], int low, int high) {
-    if (low < high) {
-        int pi = partition(arr, low, high);
-        quicksort_students(arr, low, pi - 1);
-        quicksort_students(arr, pi + 1, high);
+static void build_id_index(void) {
+    perfect_hash_free(id_index);
+    free(id_index_student);
+    id_index = NULL;
+    id_index_student = NULL;
+    if (student_count == 0) return;
+
+    uint64_t *hashes = malloc((size_t)student_count * sizeof(*hashes));
+    id_index_student = malloc((size_t)student_count * sizeof(*id_index_student));
+    if (hashes && id_index_student) {
+        for (int i = 0; i < student_count; i++) hashes[i] = id_hash(id_pool + id_offset[i]);
+        id_index = perfect_hash_build(hashes, (size_t)student_count);
     }
+    if (id_index) {
+        for (int i = 0; i < student_count; i++) {
+            id_index_student[perfect_hash_lookup(id_index, hashes[i])] = (uint32_t)i;
+        }
+    } else {
+        fprintf(stderr, "Warning: no perfect hash for the roster, falling back to binary search\n");
+        free(id_index_student);
+        id_index_student = NULL;
+    }
+    free(hashes);
 }
 
 void auth_sort_students(void) {
     if (student_count > 1) {
-        quicksort_students(student_list, 0, student_count - 1);
+        uint32_t *order = malloc((size_t)student_count * sizeof(*order));
+        if (order) {
+            for (int i = 0; i < student_count; i++) order[i] = (uint32_t)i;
+            int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+            if (!string_sort(order, (size_t)student_count, id_pool, id_offset, threads > 0 ? threads : 1)) {
+                qsort(order, (size_t)student_count, sizeof(*order), compare_students);
+            }
+            if (!apply_order(order)) fprintf(stderr, "Warning: out of memory sorting the roster\n");
+            free(order);
+        } else {
+            fprintf(stderr, "Warning: out of memory sorting the roster\n");
+        }
     }
+
+    if (issued_bits) memset(issued_bits, 0, ((size_t)student_capacity / 64 + 1) * sizeof(*issued_bits));
+    issued_count = 0;
+    build_id_index();
+    pending_reset();
 }
 
-Student *auth_find_student(const char *id) {
-    if (!id) return NULL;
+int auth_find_student(const char *id) {
+    if (!id || student_count == 0) return -1;
+
+    if (id_index) {
+        int i = (int)id_index_student[perfect_hash_lookup(id_index, id_hash(id))];
+        return strcmp(id, id_pool + id_offset[i]) == 0 ? i : -1;
+    }
+
     size_t left = 0;
     size_t right = (size_t)student_count;
-
     while (left < right) {
         size_t mid = left + (right - left) / 2;
-        int cmp = strcmp(id, student_list[mid].id);
+        int cmp = strcmp(id, id_pool + id_offset[mid]);
 
         if (cmp == 0) {
-            return &student_list[mid];
+            return (int)mid;
         } else if (cmp < 0) {
             right = mid;
         } else {
@@ -218,16 +492,44 @@ Student *auth_find_student(const char *id) {
         }
     }
 
-    return NULL;
+    return -1;
 }
 
-bool auth_all_tokens_generated(void) {
-    if (student_count == 0) return false;
-    for (int i = 0; i < student_count; i++) {
-        if (!student_list[i].token_generated) {
-            return false;
-        }
-    }
+const char *auth_student_id(int index) {
+    if (index < 0 || index >= student_count) return NULL;
+    return id_pool + id_offset[index];
+}
+
+const char *auth_student_email(int index) {
+    if (index < 0 || index >= student_count) return NULL;
+    return email[index];
+}
+
+bool auth_token_generated(int index) {
+    if (index < 0 || index >= student_count) return false;
+    uint64_t word = __atomic_load_n(&issued_bits[index / 64], __ATOMIC_ACQUIRE);
+    return (word >> (index % 64)) & 1;
+}
+
+bool auth_mark_token_generated(int index) {
+    if (index < 0 || index >= student_count) return false;
+    uint64_t bit = 1ULL << (index % 64);
+    if (__atomic_fetch_or(&issued_bits[index / 64], bit, __ATOMIC_ACQ_REL) & bit) return false;
+    __atomic_fetch_add(&issued_count, 1, __ATOMIC_RELEASE);
     return true;
 }
 
+// SHA-256 over the sorted IDs, so state keyed by roster index can tell the roster changed
+int auth_roster_fingerprint(unsigned char out[32]) {
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    // the pool holds the sorted IDs back to back with their NULs, so it is hashed in one pass
+    int ok = ctx && EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) &&
+             EVP_DigestUpdate(ctx, id_pool ? id_pool : "", id_pool_used) &&
+             EVP_DigestFinal_ex(ctx, out, NULL);
+    EVP_MD_CTX_free(ctx);
+    return ok;
+}
+
+bool auth_all_tokens_generated(void) {
+    return student_count > 0 && __atomic_load_n(&issued_count, __ATOMIC_ACQUIRE) == student_count;
+}
@@ -2,23 +2,56 @@
 #define AUTHENTICATION_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
 #include <curl/curl.h>
 
-#define NUM_STUDENTS_MAX 1000
-#define ID_SIZE 64
+#define ID_SIZE 64  // longest accepted ID, including the NUL
+#define AUTH_CODE_SIZE 8
 
-typedef struct {
-    char id[ID_SIZE];
-    char *email;
-    bool token_generated;
-} Student;
+// students are addressed by their index in the sorted roster
 
+// copies both strings; the roster grows as needed. 0 if added, 1 if the row is
+// invalid, -1 if the roster could not grow
 int auth_add_student(const char *this_id, const char *this_email);
 int auth_get_student_count(void);
+// sorts by ID, drops repeated IDs and builds the ID index; call once after the
+// last auth_add_student and before any token is marked
 void auth_sort_students(void);
-Student *auth_find_student(const char *id);
+// index of the student, or -1
+int auth_find_student(const char *id);
+const char *auth_student_id(int index);
+const char *auth_student_email(int index);
+bool auth_token_generated(int index);
+// true if this call marked the token, false if it was already marked; thread-safe
+bool auth_mark_token_generated(int index);
+int auth_roster_fingerprint(unsigned char out[32]);
+// O(1): compares a running count of marked tokens against the roster size
 bool auth_all_tokens_generated(void);
+// starts the background mail dispatcher; auth_mail_stop flushes queued mails first
+int auth_mail_start(void);
+void auth_mail_stop(void);
+// both send paths keep the new code in the pending table, replacing any earlier
+// one for the student; it expires after five minutes or three wrong entries
+int auth_send_code(const char *student_id);
+// like auth_send_code but returns once the mail is queued; done gets the send result on the mail thread
+int auth_send_code_async(const char *student_id, void (*done)(void *arg, int status), void *arg);
+int auth_prompt_code(const char *student_id);
 int auth_email_verify(const char *student_id);
 
+typedef enum {
+    AUTH_CODE_OK,       // matched; the code is used up
+    AUTH_CODE_WRONG,
+    AUTH_CODE_EXPIRED,
+    AUTH_CODE_LOCKED,   // this miss used up the last attempt
+    AUTH_CODE_NONE,     // no code outstanding for the student
+} AuthCodeResult;
+
+// the pending table is not thread-safe; check and expire from the thread that sends codes
+AuthCodeResult auth_check_code(int student, const char *code, size_t len);
+// drops every code whose deadline has passed; cost is per elapsed second, not per code
+void auth_expire_codes(time_t now);
+size_t auth_pending_codes(void);
+
 #endif
 
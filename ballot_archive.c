@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ballot_archive.h"
+
+#define ARCHIVE_WINDOW_RECORDS 65536  // ~3.5 MiB mapped at a time
+
+struct BallotArchive {
+    int fd;
+    size_t page_size;
+    uint64_t count;
+    uint64_t next;  // index of the first record of the next window
+
+    void *map;
+    size_t map_len;
+};
+
+static void unmap_window(BallotArchive *a) {
+    if (!a->map) return;
+    munmap(a->map, a->map_len);
+    a->map = NULL;
+    a->map_len = 0;
+}
+
+BallotArchive *ballot_archive_open(const char *path) {
+    BallotArchive *a = calloc(1, sizeof(*a));
+    if (!a) return NULL;
+    a->page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+    a->fd = open(path, O_RDONLY);
+    if (a->fd < 0) {
+        perror("open ballot archive");
+        free(a);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(a->fd, &st) != 0) {
+        perror("fstat ballot archive");
+        goto fail;
+    }
+    if (st.st_size < BALLOT_LOG_HEADER_SIZE || !ballot_log_header_valid(a->fd)) {
+        fprintf(stderr, "Ballot archive %s: bad header\n", path);
+        goto fail;
+    }
+    a->count = (uint64_t)(st.st_size - BALLOT_LOG_HEADER_SIZE) / sizeof(BallotRecord);
+    return a;
+
+fail:
+    close(a->fd);
+    free(a);
+    return NULL;
+}
+
+void ballot_archive_close(BallotArchive *a) {
+    if (!a) return;
+    unmap_window(a);
+    close(a->fd);
+    free(a);
+}
+
+uint64_t ballot_archive_count(const BallotArchive *a) {
+    return a->count;
+}
+
+long ballot_archive_next(BallotArchive *a, const BallotRecord **records) {
+    // dropping the previous window returns its pages, so only one window is ever resident
+    unmap_window(a);
+    if (a->next >= a->count) return 0;
+
+    uint64_t n = a->count - a->next;
+    if (n > ARCHIVE_WINDOW_RECORDS) n = ARCHIVE_WINDOW_RECORDS;
+
+    // records straddle page boundaries, so map from the page holding the first one
+    off_t start = BALLOT_LOG_HEADER_SIZE + (off_t)(a->next * sizeof(BallotRecord));
+    off_t map_start = start & ~(off_t)(a->page_size - 1);
+    a->map_len = (size_t)(start - map_start) + n * sizeof(BallotRecord);
+    a->map = mmap(NULL, a->map_len, PROT_READ, MAP_SHARED, a->fd, map_start);
+    if (a->map == MAP_FAILED) {
+        perror("mmap ballot archive");
+        a->map = NULL;
+        a->map_len = 0;
+        return -1;
+    }
+    madvise(a->map, a->map_len, MADV_SEQUENTIAL);
+
+    const BallotRecord *window = (const BallotRecord *)((const unsigned char *)a->map + (start - map_start));
+    for (uint64_t i = 0; i < n; i++) {
+        if (!ballot_log_record_valid(&window[i], a->next + i + 1)) {
+            fprintf(stderr, "Ballot archive: record %llu is damaged\n",
+                    (unsigned long long)(a->next + i + 1));
+            return -1;
+        }
+    }
+
+    a->next += n;
+    *records = window;
+    return (long)n;
+}
@@ -0,0 +1,21 @@
+#ifndef BALLOT_ARCHIVE_H
+#define BALLOT_ARCHIVE_H
+
+#include <stdint.h>
+#include "ballot_log.h"
+
+// read-only view of the ballot log for passes over every ballot; records are
+// mapped a window at a time so resident memory stays bounded however long the log is
+typedef struct BallotArchive BallotArchive;
+
+// snapshots the current length of the log; records appended later are not seen
+BallotArchive *ballot_archive_open(const char *path);
+void ballot_archive_close(BallotArchive *a);
+
+uint64_t ballot_archive_count(const BallotArchive *a);
+
+// maps the next window and points *records at it. returns the number of records
+// (0 at the end, -1 on a damaged record); the window stays valid until the next call
+long ballot_archive_next(BallotArchive *a, const BallotRecord **records);
+
+#endif
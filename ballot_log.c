@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "crc32.h"
+#include "ballot_log.h"
+
+#define BALLOT_LOG_MAGIC "EVBL"
+#define BALLOT_LOG_VERSION 1
+#define REPLAY_CHUNK_RECORDS 1024
+
+struct BallotLog {
+    int fd;
+    BallotLogPolicy policy;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;     // flusher wakeup
+    pthread_cond_t durable;  // durable_seq advanced
+    pthread_t flusher;
+
+    uint64_t written_seq;  // last record handed to write()
+    uint64_t durable_seq;  // last record covered by fdatasync
+    size_t pending;
+    struct timespec first_pending;
+    int flush_now;
+    int stop;
+    int sync_failed;
+};
+
+static uint32_t record_crc(const BallotRecord *rec) {
+    return crc32_update(0, rec, offsetof(BallotRecord, crc));
+}
+
+int ballot_log_record_valid(const BallotRecord *rec, uint64_t expected_seq) {
+    return rec->seq == expected_seq && rec->crc == record_crc(rec);
+}
+
+static void put_le32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t get_le32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+int ballot_log_header_valid(int fd) {
+    unsigned char h[BALLOT_LOG_HEADER_SIZE];
+    if (pread(fd, h, sizeof(h), 0) != (ssize_t)sizeof(h)) return 0;
+    return memcmp(h, BALLOT_LOG_MAGIC, 4) == 0 &&
+           get_le32(h + 4) == BALLOT_LOG_VERSION &&
+           get_le32(h + 8) == sizeof(BallotRecord);
+}
+
+static int write_header(int fd) {
+    unsigned char h[BALLOT_LOG_HEADER_SIZE] = {0};
+    memcpy(h, BALLOT_LOG_MAGIC, 4);
+    put_le32(h + 4, BALLOT_LOG_VERSION);
+    put_le32(h + 8, sizeof(BallotRecord));
+    if (pwrite(fd, h, sizeof(h), 0) != (ssize_t)sizeof(h)) return 0;
+    return fdatasync(fd) == 0;
+}
+
+// walks the valid prefix of the log; fn may be NULL. returns the number of valid records, -1 on error
+static long long scan_records(int fd, uint64_t after_seq, int (*fn)(const BallotRecord *, void *), void *arg) {
+    BallotRecord *chunk = malloc(REPLAY_CHUNK_RECORDS * sizeof(BallotRecord));
+    if (!chunk) return -1;
+
+    off_t off = BALLOT_LOG_HEADER_SIZE;
+    uint64_t seq = 1;
+    while (1) {
+        ssize_t n = pread(fd, chunk, REPLAY_CHUNK_RECORDS * sizeof(BallotRecord), off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            free(chunk);
+            return -1;
+        }
+
+        size_t records = (size_t)n / sizeof(BallotRecord);
+        for (size_t i = 0; i < records; i++, seq++) {
+            if (!ballot_log_record_valid(&chunk[i], seq)) goto end;
+            if (fn && seq > after_seq && !fn(&chunk[i], arg)) goto end;
+        }
+        if (records < REPLAY_CHUNK_RECORDS) break;
+        off += (off_t)(records * sizeof(BallotRecord));
+    }
+
+end:
+    free(chunk);
+    return (long long)(seq - 1);
+}
+
+static void deadline_after(struct timespec *ts, const struct timespec *from, unsigned int ms) {
+    ts->tv_sec = from->tv_sec + ms / 1000;
+    ts->tv_nsec = from->tv_nsec + (long)(ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+static void *flusher_main(void *arg) {
+    BallotLog *log = arg;
+
+    pthread_mutex_lock(&log->lock);
+    while (1) {
+        while (!log->stop && log->written_seq == log->durable_seq) {
+            pthread_cond_wait(&log->work, &log->lock);
+        }
+        if (log->written_seq == log->durable_seq) break;
+
+        // let more records join this commit until the batch fills or the window closes
+        struct timespec deadline;
+        deadline_after(&deadline, &log->first_pending, log->policy.batch_ms);
+        while (!log->stop && !log->flush_now && log->pending < log->policy.batch_records) {
+            if (pthread_cond_timedwait(&log->work, &log->lock, &deadline) == ETIMEDOUT) break;
+        }
+
+        uint64_t target = log->written_seq;
+        log->pending = 0;
+        log->flush_now = 0;
+        pthread_mutex_unlock(&log->lock);
+
+        int rc = fdatasync(log->fd);
+
+        pthread_mutex_lock(&log->lock);
+        if (rc != 0) {
+            perror("fdatasync ballot log");
+            log->sync_failed = 1;
+        } else {
+            log->durable_seq = target;
+        }
+        pthread_cond_broadcast(&log->durable);
+        if (rc != 0) break;
+    }
+    pthread_mutex_unlock(&log->lock);
+    return NULL;
+}
+
+BallotLog *ballot_log_open(const char *path, const BallotLogPolicy *policy) {
+    BallotLog *log = calloc(1, sizeof(*log));
+    if (!log) return NULL;
+
+    log->policy = *policy;
+    if (log->policy.batch_records == 0) log->policy.batch_records = 1;
+
+    log->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0600);
+    if (log->fd < 0) {
+        perror("open ballot log");
+        free(log);
+        return NULL;
+    }
+
+    // sequence numbers come from this process's own counter, and the board and
+    // tally checkpoint are written from its state, so one writer per log. the
+    // lock lasts until close
+    if (flock(log->fd, LOCK_EX | LOCK_NB) != 0) {
+        if (errno == EWOULDBLOCK) fprintf(stderr, "%s is in use by another voting process\n", path);
+        else perror("flock ballot log");
+        goto fail;
+    }
+
+    struct stat st;
+    if (fstat(log->fd, &st) != 0) goto fail;
+
+    if (st.st_size == 0) {
+        if (!write_header(log->fd)) goto fail;
+    } else {
+        if (!ballot_log_header_valid(log->fd)) {
+            fprintf(stderr, "%s is not a ballot log\n", path);
+            goto fail;
+        }
+
+        long long valid = scan_records(log->fd, 0, NULL, NULL);
+        if (valid < 0) goto fail;
+
+        off_t end = BALLOT_LOG_HEADER_SIZE + (off_t)valid * (off_t)sizeof(BallotRecord);
+        if (st.st_size != end) {
+            fprintf(stderr, "Ballot log %s: dropping %lld bytes of torn or corrupt tail\n",
+                    path, (long long)(st.st_size - end));
+            if (ftruncate(log->fd, end) != 0 || fdatasync(log->fd) != 0) goto fail;
+        }
+        log->written_seq = log->durable_seq = (uint64_t)valid;
+    }
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&log->work, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&log->durable, NULL);
+    pthread_mutex_init(&log->lock, NULL);
+
+    if (pthread_create(&log->flusher, NULL, flusher_main, log) != 0) {
+        pthread_cond_destroy(&log->work);
+        pthread_cond_destroy(&log->durable);
+        pthread_mutex_destroy(&log->lock);
+        goto fail;
+    }
+    return log;
+
+fail:
+    close(log->fd);
+    free(log);
+    return NULL;
+}
+
+void ballot_log_close(BallotLog *log) {
+    if (!log) return;
+
+    pthread_mutex_lock(&log->lock);
+    log->stop = 1;
+    pthread_cond_signal(&log->work);
+    pthread_mutex_unlock(&log->lock);
+    pthread_join(log->flusher, NULL);
+
+    pthread_cond_destroy(&log->work);
+    pthread_cond_destroy(&log->durable);
+    pthread_mutex_destroy(&log->lock);
+    close(log->fd);
+    free(log);
+}
+
+int ballot_log_append(BallotLog *log, const unsigned char token_hash[BALLOT_LOG_HASH_BYTES],
+                      uint64_t ciphertext, uint64_t *seq_out) {
+    BallotRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    memcpy(rec.token_hash, token_hash, BALLOT_LOG_HASH_BYTES);
+    rec.ciphertext = ciphertext;
+
+    pthread_mutex_lock(&log->lock);
+    if (log->sync_failed) {
+        pthread_mutex_unlock(&log->lock);
+        return 0;
+    }
+
+    rec.seq = log->written_seq + 1;
+    rec.crc = record_crc(&rec);
+
+    ssize_t n;
+    do {
+        n = write(log->fd, &rec, sizeof(rec));
+    } while (n < 0 && errno == EINTR);
+    if (n != (ssize_t)sizeof(rec)) {
+        perror("write ballot log");
+        if (n > 0 && ftruncate(log->fd, BALLOT_LOG_HEADER_SIZE + (off_t)log->written_seq * (off_t)sizeof(rec)) != 0) {
+            log->sync_failed = 1;
+        }
+        pthread_mutex_unlock(&log->lock);
+        return 0;
+    }
+
+    log->written_seq = rec.seq;
+    if (log->pending++ == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &log->first_pending);
+    }
+    pthread_cond_signal(&log->work);
+    pthread_mutex_unlock(&log->lock);
+
+    if (seq_out) *seq_out = rec.seq;
+    return 1;
+}
+
+int ballot_log_wait_durable(BallotLog *log, uint64_t seq) {
+    pthread_mutex_lock(&log->lock);
+    if (seq > log->durable_seq) {
+        log->flush_now = 1;
+        pthread_cond_signal(&log->work);
+    }
+    while (seq > log->durable_seq && !log->sync_failed) {
+        pthread_cond_wait(&log->durable, &log->lock);
+    }
+    int ok = seq <= log->durable_seq;
+    pthread_mutex_unlock(&log->lock);
+    return ok;
+}
+
+uint64_t ballot_log_count(const BallotLog *log) {
+    return log->written_seq;
+}
+
+int ballot_log_replay(const char *path, uint64_t after_seq,
+                      int (*fn)(const BallotRecord *rec, void *arg), void *arg) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return errno == ENOENT;
+
+    int ok = ballot_log_header_valid(fd) && scan_records(fd, after_seq, fn, arg) >= 0;
+    close(fd);
+    return ok;
+}
@@ -0,0 +1,51 @@
+#ifndef BALLOT_LOG_H
+#define BALLOT_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BALLOT_LOG_HASH_BYTES 32
+
+// one accepted ballot, fixed size on disk (host byte order)
+typedef struct {
+    uint64_t seq;
+    unsigned char token_hash[BALLOT_LOG_HASH_BYTES];
+    uint64_t ciphertext;
+    uint32_t reserved;
+    uint32_t crc;  // over all fields above
+} BallotRecord;
+
+#define BALLOT_LOG_HEADER_SIZE 16
+
+// group commit: records are written immediately but fdatasync'd by a background
+// thread once batch_records are pending or the oldest pending one is batch_ms old
+typedef struct {
+    size_t batch_records;
+    unsigned int batch_ms;
+} BallotLogPolicy;
+
+typedef struct BallotLog BallotLog;
+
+// opens or creates the log, dropping a torn or corrupt tail left by a crash.
+// holds an exclusive lock while open; NULL if another process has the log
+BallotLog *ballot_log_open(const char *path, const BallotLogPolicy *policy);
+// flushes everything still pending, then closes
+void ballot_log_close(BallotLog *log);
+
+// appends without waiting for the disk; the assigned sequence number goes to seq_out
+int ballot_log_append(BallotLog *log, const unsigned char token_hash[BALLOT_LOG_HASH_BYTES],
+                      uint64_t ciphertext, uint64_t *seq_out);
+// blocks until every record up to and including seq is on stable storage
+int ballot_log_wait_durable(BallotLog *log, uint64_t seq);
+
+uint64_t ballot_log_count(const BallotLog *log);
+
+// calls fn for every valid record with seq > after_seq; stops early if fn returns 0
+int ballot_log_replay(const char *path, uint64_t after_seq,
+                      int (*fn)(const BallotRecord *rec, void *arg), void *arg);
+
+// checks the file header and one record's sequence number and crc, for readers outside this module
+int ballot_log_header_valid(int fd);
+int ballot_log_record_valid(const BallotRecord *rec, uint64_t expected_seq);
+
+#endif
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <openssl/bn.h>
+#include "blind_pool.h"
+
+struct BlindPool {
+    BIGNUM *N;
+    BIGNUM *e;
+
+    BlindFactor *ring;
+    size_t capacity;
+    size_t head;
+    size_t count;
+
+    int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t not_full;
+    pthread_t worker;
+};
+
+// r is drawn until it is invertible mod N, which is the same as gcd(r, N) == 1,
+// so the inverse doubles as the coprimality check
+int blind_factor_compute(BlindFactor *f, const BIGNUM *N, const BIGNUM *e, BN_CTX *ctx) {
+    BIGNUM *r = BN_new();
+    BIGNUM *r_e = BN_new();
+    BIGNUM *r_inv = BN_new();
+    if (!r || !r_e || !r_inv) goto fail;
+
+    while (1) {
+        if (!BN_rand_range(r, N)) goto fail;
+        if (BN_is_zero(r)) continue;
+        if (BN_mod_inverse(r_inv, r, N, ctx)) break;
+    }
+
+    if (!BN_mod_exp(r_e, r, e, N, ctx)) goto fail;
+
+    f->r = r;
+    f->r_e = r_e;
+    f->r_inv = r_inv;
+    return 1;
+
+fail:
+    BN_clear_free(r);
+    BN_clear_free(r_e);
+    BN_clear_free(r_inv);
+    return 0;
+}
+
+void blind_factor_clear(BlindFactor *f) {
+    if (!f) return;
+    BN_clear_free(f->r);
+    BN_clear_free(f->r_e);
+    BN_clear_free(f->r_inv);
+    f->r = f->r_e = f->r_inv = NULL;
+}
+
+static void *blind_pool_worker(void *arg) {
+    BlindPool *pool = arg;
+    BN_CTX *ctx = BN_CTX_new();
+    if (!ctx) {
+        fprintf(stderr, "blind pool: BN_CTX_new failed\n");
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stop) {
+        if (pool->count == pool->capacity) {
+            pthread_cond_wait(&pool->not_full, &pool->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        BlindFactor f;
+        int ok = blind_factor_compute(&f, pool->N, pool->e, ctx);
+
+        pthread_mutex_lock(&pool->lock);
+        if (!ok) {
+            fprintf(stderr, "blind pool: failed to precompute blinding factor\n");
+            break;
+        }
+        if (pool->stop) {
+            blind_factor_clear(&f);
+            break;
+        }
+        pool->ring[(pool->head + pool->count) % pool->capacity] = f;
+        pool->count++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    BN_CTX_free(ctx);
+    return NULL;
+}
+
+BlindPool *blind_pool_create(const BIGNUM *N, const BIGNUM *e, size_t capacity) {
+    if (!N || !e || capacity == 0) return NULL;
+
+    BlindPool *pool = calloc(1, sizeof(*pool));
+    if (!pool) return NULL;
+
+    pool->N = BN_dup(N);
+    pool->e = BN_dup(e);
+    pool->ring = calloc(capacity, sizeof(BlindFactor));
+    pool->capacity = capacity;
+    if (!pool->N || !pool->e || !pool->ring) goto fail;
+
+    if (pthread_mutex_init(&pool->lock, NULL) != 0) goto fail;
+    if (pthread_cond_init(&pool->not_full, NULL) != 0) {
+        pthread_mutex_destroy(&pool->lock);
+        goto fail;
+    }
+    if (pthread_create(&pool->worker, NULL, blind_pool_worker, pool) != 0) {
+        pthread_cond_destroy(&pool->not_full);
+        pthread_mutex_destroy(&pool->lock);
+        goto fail;
+    }
+    return pool;
+
+fail:
+    BN_free(pool->N);
+    BN_free(pool->e);
+    free(pool->ring);
+    free(pool);
+    return NULL;
+}
+
+int blind_pool_take(BlindPool *pool, BlindFactor *out, BN_CTX *ctx) {
+    if (!pool || !out) return 0;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->count > 0) {
+        *out = pool->ring[pool->head];
+        memset(&pool->ring[pool->head], 0, sizeof(BlindFactor));
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->count--;
+        pthread_cond_signal(&pool->not_full);
+        pthread_mutex_unlock(&pool->lock);
+        return 1;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    // pool drained faster than the worker refills it, pay the offline cost now
+    return blind_factor_compute(out, pool->N, pool->e, ctx);
+}
+
+void blind_pool_destroy(BlindPool *pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->not_full);
+    pthread_mutex_unlock(&pool->lock);
+    pthread_join(pool->worker, NULL);
+
+    while (pool->count > 0) {
+        blind_factor_clear(&pool->ring[pool->head]);
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->count--;
+    }
+
+    pthread_cond_destroy(&pool->not_full);
+    pthread_mutex_destroy(&pool->lock);
+    BN_free(pool->N);
+    BN_free(pool->e);
+    free(pool->ring);
+    free(pool);
+}
@@ -0,0 +1,27 @@
+#ifndef BLIND_POOL_H
+#define BLIND_POOL_H
+
+#include <stddef.h>
+#include <openssl/bn.h>
+
+// one precomputed blinding triple for a fixed public key (N, e)
+typedef struct {
+    BIGNUM *r;
+    BIGNUM *r_e;    // r^e mod N, multiplied into m when blinding
+    BIGNUM *r_inv;  // r^-1 mod N, multiplied into s' when unblinding
+} BlindFactor;
+
+typedef struct BlindPool BlindPool;
+
+int blind_factor_compute(BlindFactor *f, const BIGNUM *N, const BIGNUM *e, BN_CTX *ctx);
+void blind_factor_clear(BlindFactor *f);
+
+// starts a background thread that keeps up to `capacity` triples ready
+BlindPool *blind_pool_create(const BIGNUM *N, const BIGNUM *e, size_t capacity);
+
+// returns 1 on success; computes the triple inline if the pool is empty
+int blind_pool_take(BlindPool *pool, BlindFactor *out, BN_CTX *ctx);
+
+void blind_pool_destroy(BlindPool *pool);
+
+#endif
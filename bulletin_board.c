@@ -0,0 +1,464 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <openssl/sha.h>
+#include "bulletin_board.h"
+
+#define BOARD_MAGIC "EVBB"
+#define BOARD_VERSION 1
+#define BOARD_HEADER_SIZE 16
+#define BOARD_ENTRY_SIZE (8 + BOARD_TOKEN_BYTES + 8)
+#define BOARD_LEVELS 64
+#define READ_CHUNK_ENTRIES 1024
+
+struct BoardWriter {
+    int fd;
+    uint64_t size;
+    int broken;  // an append failed; later entries would leave a gap, so none are taken
+    unsigned char frontier[BOARD_LEVELS][BOARD_HASH_BYTES];  // level k valid when bit k of size is set
+};
+
+struct BoardTree {
+    uint64_t size;
+    unsigned char *entries;  // raw entries in leaf order
+    unsigned char *levels[BOARD_LEVELS];  // levels[k][i]: perfect subtree over leaves [i << k, (i + 1) << k)
+    int level_count;
+};
+
+static void put_be64(unsigned char *p, uint64_t v) {
+    for (int i = 7; i >= 0; i--) {
+        p[i] = (unsigned char)v;
+        v >>= 8;
+    }
+}
+
+static uint64_t get_be64(const unsigned char *p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v = (v << 8) | p[i];
+    return v;
+}
+
+static void encode_entry(const BoardEntry *e, unsigned char out[BOARD_ENTRY_SIZE]) {
+    put_be64(out, e->seq);
+    memcpy(out + 8, e->token_hash, BOARD_TOKEN_BYTES);
+    put_be64(out + 8 + BOARD_TOKEN_BYTES, e->ciphertext);
+}
+
+static void decode_entry(const unsigned char in[BOARD_ENTRY_SIZE], BoardEntry *e) {
+    e->seq = get_be64(in);
+    memcpy(e->token_hash, in + 8, BOARD_TOKEN_BYTES);
+    e->ciphertext = get_be64(in + 8 + BOARD_TOKEN_BYTES);
+}
+
+static void leaf_hash_raw(const unsigned char entry[BOARD_ENTRY_SIZE], unsigned char out[BOARD_HASH_BYTES]) {
+    unsigned char buf[1 + BOARD_ENTRY_SIZE];
+    buf[0] = 0x00;
+    memcpy(buf + 1, entry, BOARD_ENTRY_SIZE);
+    SHA256(buf, sizeof(buf), out);
+}
+
+void board_leaf_hash(const BoardEntry *entry, unsigned char out[BOARD_HASH_BYTES]) {
+    unsigned char raw[BOARD_ENTRY_SIZE];
+    encode_entry(entry, raw);
+    leaf_hash_raw(raw, out);
+}
+
+static void node_hash(const unsigned char *left, const unsigned char *right, unsigned char out[BOARD_HASH_BYTES]) {
+    unsigned char buf[1 + 2 * BOARD_HASH_BYTES];
+    buf[0] = 0x01;
+    memcpy(buf + 1, left, BOARD_HASH_BYTES);
+    memcpy(buf + 1 + BOARD_HASH_BYTES, right, BOARD_HASH_BYTES);
+    SHA256(buf, sizeof(buf), out);
+}
+
+// largest power of two strictly below n, n >= 2
+static uint64_t split_point(uint64_t n) {
+    uint64_t k = 1;
+    while (k << 1 < n) k <<= 1;
+    return k;
+}
+
+static int check_header(int fd) {
+    unsigned char h[BOARD_HEADER_SIZE];
+    if (pread(fd, h, sizeof(h), 0) != (ssize_t)sizeof(h)) return 0;
+    return memcmp(h, BOARD_MAGIC, 4) == 0 && h[4] == BOARD_VERSION && h[5] == BOARD_ENTRY_SIZE;
+}
+
+// streams every complete entry to fn; returns how many there were, -1 on error
+static long long scan_entries(int fd, void (*fn)(const unsigned char *, void *), void *arg) {
+    unsigned char *chunk = malloc((size_t)READ_CHUNK_ENTRIES * BOARD_ENTRY_SIZE);
+    if (!chunk) return -1;
+
+    off_t off = BOARD_HEADER_SIZE;
+    long long count = 0;
+    while (1) {
+        ssize_t n = pread(fd, chunk, (size_t)READ_CHUNK_ENTRIES * BOARD_ENTRY_SIZE, off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            free(chunk);
+            return -1;
+        }
+        size_t entries = (size_t)n / BOARD_ENTRY_SIZE;
+        for (size_t i = 0; i < entries; i++) fn(chunk + i * BOARD_ENTRY_SIZE, arg);
+        count += (long long)entries;
+        if (entries < READ_CHUNK_ENTRIES) break;
+        off += (off_t)(entries * BOARD_ENTRY_SIZE);
+    }
+    free(chunk);
+    return count;
+}
+
+static void frontier_push(BoardWriter *w, const unsigned char leaf[BOARD_HASH_BYTES]) {
+    unsigned char h[BOARD_HASH_BYTES];
+    memcpy(h, leaf, BOARD_HASH_BYTES);
+    int level = 0;
+    while ((w->size >> level) & 1) {
+        node_hash(w->frontier[level], h, h);
+        level++;
+    }
+    memcpy(w->frontier[level], h, BOARD_HASH_BYTES);
+    w->size++;
+}
+
+static void rebuild_frontier(const unsigned char *entry, void *arg) {
+    unsigned char leaf[BOARD_HASH_BYTES];
+    leaf_hash_raw(entry, leaf);
+    frontier_push(arg, leaf);
+}
+
+BoardWriter *board_writer_open(const char *path) {
+    BoardWriter *w = calloc(1, sizeof(*w));
+    if (!w) return NULL;
+
+    w->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (w->fd < 0) {
+        perror("open bulletin board");
+        free(w);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(w->fd, &st) != 0) goto fail;
+
+    if (st.st_size == 0) {
+        unsigned char h[BOARD_HEADER_SIZE] = {0};
+        memcpy(h, BOARD_MAGIC, 4);
+        h[4] = BOARD_VERSION;
+        h[5] = BOARD_ENTRY_SIZE;
+        if (write(w->fd, h, sizeof(h)) != (ssize_t)sizeof(h) || fdatasync(w->fd) != 0) goto fail;
+        return w;
+    }
+
+    if (!check_header(w->fd)) {
+        fprintf(stderr, "%s is not a bulletin board\n", path);
+        goto fail;
+    }
+    if (scan_entries(w->fd, rebuild_frontier, w) < 0) goto fail;
+
+    off_t end = BOARD_HEADER_SIZE + (off_t)w->size * BOARD_ENTRY_SIZE;
+    if (st.st_size != end && (ftruncate(w->fd, end) != 0 || fdatasync(w->fd) != 0)) goto fail;
+    return w;
+
+fail:
+    close(w->fd);
+    free(w);
+    return NULL;
+}
+
+int board_writer_sync(BoardWriter *w) {
+    return fdatasync(w->fd) == 0;
+}
+
+int board_writer_close(BoardWriter *w) {
+    if (!w) return 1;
+    int ok = board_writer_sync(w);
+    if (close(w->fd) != 0) ok = 0;
+    free(w);
+    return ok;
+}
+
+int board_writer_append(BoardWriter *w, const BoardEntry *entry) {
+    if (w->broken) return 0;
+    if (entry->seq != w->size + 1) {
+        fprintf(stderr, "Bulletin board holds %llu entries, refusing seq %llu\n",
+                (unsigned long long)w->size, (unsigned long long)entry->seq);
+        w->broken = 1;
+        return 0;
+    }
+
+    unsigned char raw[BOARD_ENTRY_SIZE];
+    encode_entry(entry, raw);
+
+    ssize_t n;
+    do {
+        n = write(w->fd, raw, sizeof(raw));
+    } while (n < 0 && errno == EINTR);
+    if (n != (ssize_t)sizeof(raw)) {
+        perror("write bulletin board");
+        if (n > 0 && ftruncate(w->fd, BOARD_HEADER_SIZE + (off_t)w->size * BOARD_ENTRY_SIZE) != 0) {
+            perror("truncate bulletin board");
+        }
+        w->broken = 1;
+        return 0;
+    }
+
+    unsigned char leaf[BOARD_HASH_BYTES];
+    leaf_hash_raw(raw, leaf);
+    frontier_push(w, leaf);
+    return 1;
+}
+
+int board_writer_broken(const BoardWriter *w) {
+    return w->broken;
+}
+
+uint64_t board_writer_size(const BoardWriter *w) {
+    return w->size;
+}
+
+// perfect subtrees fold from the smallest (rightmost) up, as in MTH
+void board_writer_root(const BoardWriter *w, unsigned char root[BOARD_HASH_BYTES]) {
+    if (w->size == 0) {
+        SHA256(NULL, 0, root);
+        return;
+    }
+    int level = 0;
+    while (!((w->size >> level) & 1)) level++;
+    memcpy(root, w->frontier[level], BOARD_HASH_BYTES);
+    for (level++; level < BOARD_LEVELS; level++) {
+        if ((w->size >> level) & 1) node_hash(w->frontier[level], root, root);
+    }
+}
+
+typedef struct {
+    BoardTree *t;
+    uint64_t next;
+} LoadState;
+
+static void load_entry(const unsigned char *entry, void *arg) {
+    LoadState *ls = arg;
+    if (ls->next == ls->t->size) return;  // appended after we sized the arrays
+    memcpy(ls->t->entries + ls->next * BOARD_ENTRY_SIZE, entry, BOARD_ENTRY_SIZE);
+    leaf_hash_raw(entry, ls->t->levels[0] + ls->next * BOARD_HASH_BYTES);
+    ls->next++;
+}
+
+BoardTree *board_tree_load(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("open bulletin board");
+        return NULL;
+    }
+
+    BoardTree *t = calloc(1, sizeof(*t));
+    struct stat st;
+    if (!t || fstat(fd, &st) != 0 || !check_header(fd)) goto fail;
+
+    t->size = st.st_size > BOARD_HEADER_SIZE ? (uint64_t)(st.st_size - BOARD_HEADER_SIZE) / BOARD_ENTRY_SIZE : 0;
+    t->entries = malloc(t->size ? t->size * BOARD_ENTRY_SIZE : 1);
+    t->levels[0] = malloc(t->size ? t->size * BOARD_HASH_BYTES : 1);
+    t->level_count = 1;
+    if (!t->entries || !t->levels[0]) goto fail;
+
+    LoadState ls = { t, 0 };
+    if (scan_entries(fd, load_entry, &ls) < 0 || ls.next < t->size) goto fail;
+
+    for (uint64_t width = t->size / 2; width > 0; width /= 2) {
+        unsigned char *below = t->levels[t->level_count - 1];
+        unsigned char *level = malloc(width * BOARD_HASH_BYTES);
+        if (!level) goto fail;
+        for (uint64_t i = 0; i < width; i++) {
+            node_hash(below + 2 * i * BOARD_HASH_BYTES, below + (2 * i + 1) * BOARD_HASH_BYTES,
+                      level + i * BOARD_HASH_BYTES);
+        }
+        t->levels[t->level_count++] = level;
+    }
+
+    close(fd);
+    return t;
+
+fail:
+    fprintf(stderr, "Failed to load bulletin board %s\n", path);
+    close(fd);
+    board_tree_free(t);
+    return NULL;
+}
+
+void board_tree_free(BoardTree *t) {
+    if (!t) return;
+    for (int i = 0; i < t->level_count; i++) free(t->levels[i]);
+    free(t->entries);
+    free(t);
+}
+
+uint64_t board_tree_size(const BoardTree *t) {
+    return t->size;
+}
+
+int board_tree_entry(const BoardTree *t, uint64_t index, BoardEntry *entry) {
+    if (index >= t->size) return 0;
+    decode_entry(t->entries + index * BOARD_ENTRY_SIZE, entry);
+    return 1;
+}
+
+long long board_tree_find(const BoardTree *t, const unsigned char token_hash[BOARD_TOKEN_BYTES]) {
+    for (uint64_t i = 0; i < t->size; i++) {
+        if (memcmp(t->entries + i * BOARD_ENTRY_SIZE + 8, token_hash, BOARD_TOKEN_BYTES) == 0) return (long long)i;
+    }
+    return -1;
+}
+
+// MTH over leaves [a, b); aligned power-of-two ranges come straight from the levels
+static void subtree_hash(const BoardTree *t, uint64_t a, uint64_t b, unsigned char out[BOARD_HASH_BYTES]) {
+    uint64_t n = b - a;
+    if ((n & (n - 1)) == 0 && a % n == 0) {
+        int level = 0;
+        while ((1ULL << level) < n) level++;
+        memcpy(out, t->levels[level] + (a >> level) * BOARD_HASH_BYTES, BOARD_HASH_BYTES);
+        return;
+    }
+    uint64_t k = split_point(n);
+    unsigned char left[BOARD_HASH_BYTES], right[BOARD_HASH_BYTES];
+    subtree_hash(t, a, a + k, left);
+    subtree_hash(t, a + k, b, right);
+    node_hash(left, right, out);
+}
+
+int board_tree_root(const BoardTree *t, uint64_t size, unsigned char root[BOARD_HASH_BYTES]) {
+    if (size > t->size) return 0;
+    if (size == 0) {
+        SHA256(NULL, 0, root);
+        return 1;
+    }
+    subtree_hash(t, 0, size, root);
+    return 1;
+}
+
+// PATH(m, D[a:b]) from RFC 6962, leaf-to-root order
+static int inclusion_path(const BoardTree *t, uint64_t m, uint64_t a, uint64_t b,
+                          unsigned char path[][BOARD_HASH_BYTES]) {
+    if (b - a == 1) return 0;
+    uint64_t k = split_point(b - a);
+    int len;
+    if (m < k) {
+        len = inclusion_path(t, m, a, a + k, path);
+        subtree_hash(t, a + k, b, path[len]);
+    } else {
+        len = inclusion_path(t, m - k, a + k, b, path);
+        subtree_hash(t, a, a + k, path[len]);
+    }
+    return len + 1;
+}
+
+int board_tree_inclusion_proof(const BoardTree *t, uint64_t index, uint64_t size,
+                               unsigned char path[][BOARD_HASH_BYTES]) {
+    if (size > t->size || index >= size) return -1;
+    return inclusion_path(t, index, 0, size, path);
+}
+
+// SUBPROOF(m, D[a:b], complete) from RFC 6962
+static int consistency_path(const BoardTree *t, uint64_t m, uint64_t a, uint64_t b, int complete,
+                            unsigned char path[][BOARD_HASH_BYTES]) {
+    uint64_t n = b - a;
+    if (m == n) {
+        if (complete) return 0;
+        subtree_hash(t, a, b, path[0]);
+        return 1;
+    }
+    uint64_t k = split_point(n);
+    int len;
+    if (m <= k) {
+        len = consistency_path(t, m, a, a + k, complete, path);
+        subtree_hash(t, a + k, b, path[len]);
+    } else {
+        len = consistency_path(t, m - k, a + k, b, 0, path);
+        subtree_hash(t, a, a + k, path[len]);
+    }
+    return len + 1;
+}
+
+int board_tree_consistency_proof(const BoardTree *t, uint64_t old_size, uint64_t new_size,
+                                 unsigned char path[][BOARD_HASH_BYTES]) {
+    if (new_size > t->size || old_size > new_size) return -1;
+    if (old_size == 0 || old_size == new_size) return 0;
+    return consistency_path(t, old_size, 0, new_size, 1, path);
+}
+
+// RFC 9162 section 2.1.3.2
+int board_verify_inclusion(const unsigned char leaf[BOARD_HASH_BYTES], uint64_t index, uint64_t size,
+                           unsigned char path[][BOARD_HASH_BYTES], int path_len,
+                           const unsigned char root[BOARD_HASH_BYTES]) {
+    if (index >= size) return 0;
+
+    uint64_t fn = index, sn = size - 1;
+    unsigned char r[BOARD_HASH_BYTES];
+    memcpy(r, leaf, BOARD_HASH_BYTES);
+    for (int i = 0; i < path_len; i++) {
+        if (sn == 0) return 0;
+        if ((fn & 1) || fn == sn) {
+            node_hash(path[i], r, r);
+            while (!(fn & 1) && fn != 0) {
+                fn >>= 1;
+                sn >>= 1;
+            }
+        } else {
+            node_hash(r, path[i], r);
+        }
+        fn >>= 1;
+        sn >>= 1;
+    }
+    return sn == 0 && memcmp(r, root, BOARD_HASH_BYTES) == 0;
+}
+
+// RFC 9162 section 2.1.4.2
+int board_verify_consistency(uint64_t old_size, uint64_t new_size,
+                             const unsigned char old_root[BOARD_HASH_BYTES],
+                             const unsigned char new_root[BOARD_HASH_BYTES],
+                             unsigned char path[][BOARD_HASH_BYTES], int path_len) {
+    if (old_size > new_size) return 0;
+    if (old_size == 0) return path_len == 0;
+    if (old_size == new_size) return path_len == 0 && memcmp(old_root, new_root, BOARD_HASH_BYTES) == 0;
+    if (path_len < 1) return 0;
+
+    // a power-of-two old tree is itself a node of the new one and starts the chain
+    int start = 0;
+    unsigned char first[BOARD_HASH_BYTES];
+    if ((old_size & (old_size - 1)) == 0) {
+        memcpy(first, old_root, BOARD_HASH_BYTES);
+    } else {
+        memcpy(first, path[0], BOARD_HASH_BYTES);
+        start = 1;
+    }
+
+    uint64_t fn = old_size - 1, sn = new_size - 1;
+    while (fn & 1) {
+        fn >>= 1;
+        sn >>= 1;
+    }
+
+    unsigned char fr[BOARD_HASH_BYTES], sr[BOARD_HASH_BYTES];
+    memcpy(fr, first, BOARD_HASH_BYTES);
+    memcpy(sr, first, BOARD_HASH_BYTES);
+    for (int i = start; i < path_len; i++) {
+        if (sn == 0) return 0;
+        if ((fn & 1) || fn == sn) {
+            node_hash(path[i], fr, fr);
+            node_hash(path[i], sr, sr);
+            while (!(fn & 1) && fn != 0) {
+                fn >>= 1;
+                sn >>= 1;
+            }
+        } else {
+            node_hash(sr, path[i], sr);
+        }
+        fn >>= 1;
+        sn >>= 1;
+    }
+    return sn == 0 &&
+           memcmp(fr, old_root, BOARD_HASH_BYTES) == 0 &&
+           memcmp(sr, new_root, BOARD_HASH_BYTES) == 0;
+}
@@ -0,0 +1,63 @@
+#ifndef BULLETIN_BOARD_H
+#define BULLETIN_BOARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BOARD_HASH_BYTES 32
+#define BOARD_TOKEN_BYTES 32
+#define BOARD_MAX_PROOF 65  // hashes in the longest proof for a 64-bit tree size
+
+// append-only public board of accepted ballots with an RFC 6962 style Merkle
+// tree over them: leaf = SHA-256(0x00 || entry), node = SHA-256(0x01 || left || right).
+// an entry is seq (u64 BE) | token hash | ciphertext (u64 BE), and leaf i holds seq i + 1
+typedef struct {
+    uint64_t seq;
+    unsigned char token_hash[BOARD_TOKEN_BYTES];
+    uint64_t ciphertext;
+} BoardEntry;
+
+// the writer keeps only the O(log n) frontier of perfect subtree roots, so the
+// voting process can publish roots without holding the tree
+typedef struct BoardWriter BoardWriter;
+
+// opens or creates the board, dropping a torn final entry, and rebuilds the frontier
+BoardWriter *board_writer_open(const char *path);
+int board_writer_close(BoardWriter *w);
+// entry->seq must be the next one. after a failure every later append is refused,
+// so the board stays a gap-free prefix of the ballot log for the next start to extend
+int board_writer_append(BoardWriter *w, const BoardEntry *entry);
+int board_writer_broken(const BoardWriter *w);
+int board_writer_sync(BoardWriter *w);
+uint64_t board_writer_size(const BoardWriter *w);
+void board_writer_root(const BoardWriter *w, unsigned char root[BOARD_HASH_BYTES]);
+
+// full tree rebuilt from the board file, for answering proof requests
+typedef struct BoardTree BoardTree;
+
+BoardTree *board_tree_load(const char *path);
+void board_tree_free(BoardTree *t);
+uint64_t board_tree_size(const BoardTree *t);
+int board_tree_entry(const BoardTree *t, uint64_t index, BoardEntry *entry);
+// index of the ballot cast with token_hash, or -1
+long long board_tree_find(const BoardTree *t, const unsigned char token_hash[BOARD_TOKEN_BYTES]);
+// root of the first size leaves, as it was published when the board had that size
+int board_tree_root(const BoardTree *t, uint64_t size, unsigned char root[BOARD_HASH_BYTES]);
+
+// both proofs write at most BOARD_MAX_PROOF hashes into path and return how many, or -1 on bad arguments
+int board_tree_inclusion_proof(const BoardTree *t, uint64_t index, uint64_t size,
+                               unsigned char path[][BOARD_HASH_BYTES]);
+int board_tree_consistency_proof(const BoardTree *t, uint64_t old_size, uint64_t new_size,
+                                 unsigned char path[][BOARD_HASH_BYTES]);
+
+// verification needs only the proof and the published roots, never the board
+void board_leaf_hash(const BoardEntry *entry, unsigned char out[BOARD_HASH_BYTES]);
+int board_verify_inclusion(const unsigned char leaf[BOARD_HASH_BYTES], uint64_t index, uint64_t size,
+                           unsigned char path[][BOARD_HASH_BYTES], int path_len,
+                           const unsigned char root[BOARD_HASH_BYTES]);
+int board_verify_consistency(uint64_t old_size, uint64_t new_size,
+                             const unsigned char old_root[BOARD_HASH_BYTES],
+                             const unsigned char new_root[BOARD_HASH_BYTES],
+                             unsigned char path[][BOARD_HASH_BYTES], int path_len);
+
+#endif
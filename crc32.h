@@ -0,0 +1,10 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3, same as zlib). pass 0 as crc to start, or a previous result to continue.
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+
+#endif
@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <openssl/crypto.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+#include "entropy.h"
+
+#define RESEED_BYTES 32
+
+static pthread_mutex_t entropy_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t entropy_wake;  // monotonic clock, set up with the thread
+static pthread_t reseed_thread;
+static int seeded = 0;
+static int reseeding = 0;  // reseed thread running
+static int stopping = 0;
+static int reseed_started = 0;  // tried once; a failed start is not retried on every call
+static uint64_t reseeds = 0;
+
+static int collect_mouse_entropy(double duration_seconds, int verbose) {
+    unsigned char entropy_buffer[256];
+    size_t entropy_collected = 0;
+    int mouse_fd = -1;
+
+    const char *mouse_devices[] = {
+        "/dev/input/mice",
+        "/dev/input/mouse0",
+        "/dev/psaux",
+        NULL
+    };
+
+    for (int i = 0; mouse_devices[i] != NULL; i++) {
+        mouse_fd = open(mouse_devices[i], O_RDONLY | O_NONBLOCK);
+        if (mouse_fd >= 0) {
+            if (verbose) printf("Reading from %s\n", mouse_devices[i]);
+            break;
+        }
+    }
+
+    if (verbose && mouse_fd < 0) {
+        printf("Cannot access mouse devices (try: sudo chmod +r /dev/input/mice)\n");
+        printf("Falling back to timing-based entropy collection...\n");
+    }
+
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (verbose) {
+        printf("Collecting entropy");
+        fflush(stdout);
+    }
+
+    int dot_counter = 0;
+    while (1) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double elapsed = (now.tv_sec - start.tv_sec) +
+                         (now.tv_nsec - start.tv_nsec) / 1e9;
+
+        if (elapsed >= duration_seconds) break;
+
+        if (verbose && ++dot_counter % 10 == 0) {
+            printf(".");
+            fflush(stdout);
+        }
+
+        if (mouse_fd >= 0) {
+            unsigned char mouse_data[32];
+            ssize_t n = read(mouse_fd, mouse_data, sizeof(mouse_data));
+            if (n > 0) {
+                for (ssize_t i = 0; i < n && entropy_collected < sizeof(entropy_buffer); i++) {
+                    entropy_buffer[entropy_collected++] = mouse_data[i];
+                }
+            }
+        }
+
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        if (entropy_collected < sizeof(entropy_buffer)) {
+            entropy_buffer[entropy_collected++] = (unsigned char)(ts.tv_nsec & 0xFF);
+        }
+
+        usleep(10000);
+    }
+
+    if (verbose) printf(" done!\n");
+
+    if (mouse_fd >= 0) {
+        close(mouse_fd);
+    }
+
+    if (entropy_collected > 0) {
+        unsigned char hash[SHA256_DIGEST_LENGTH];
+        SHA256(entropy_buffer, entropy_collected, hash);
+        RAND_add(hash, sizeof(hash), (double)entropy_collected / 4.0);
+
+        if (verbose) printf("Collected %zu bytes of entropy from mouse/timing\n", entropy_collected);
+
+        OPENSSL_cleanse(entropy_buffer, sizeof(entropy_buffer));
+        OPENSSL_cleanse(hash, sizeof(hash));
+        return 1;
+    }
+
+    return 0;
+}
+
+static int seed_from_device(const char *path, size_t bytes) {
+    unsigned char buf[64];
+    if (bytes > sizeof(buf)) {
+        bytes = sizeof(buf);
+    }
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+
+    size_t r = fread(buf, 1, bytes, f);
+    fclose(f);
+
+    if (r != bytes) {
+        fprintf(stderr, "Not enough entropy from %s\n", path);
+        return 0;
+    }
+
+    RAND_add(buf, (int)bytes, (double)bytes);
+    OPENSSL_cleanse(buf, sizeof(buf));
+    return 1;
+}
+
+static void *reseed_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&entropy_lock);
+    while (!stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += ENTROPY_RESEED_SECONDS;
+        int rc = 0;
+        while (!stopping && rc != ETIMEDOUT) rc = pthread_cond_timedwait(&entropy_wake, &entropy_lock, &deadline);
+        if (stopping) break;
+        pthread_mutex_unlock(&entropy_lock);
+
+        // the generator is thread-safe, so callers keep drawing while this runs
+        int ok = seed_from_device("/dev/urandom", RESEED_BYTES);
+
+        pthread_mutex_lock(&entropy_lock);
+        if (ok) reseeds++;
+    }
+    pthread_mutex_unlock(&entropy_lock);
+    return NULL;
+}
+
+static int seed_once(int verbose) {
+    if (RAND_poll() != 1) {
+        fprintf(stderr, "RAND_poll failed\n");
+        return 0;
+    }
+
+    if (verbose) {
+        printf("\nCollecting User Entropy\n");
+        printf("Please move your mouse randomly!\n");
+        printf("Collecting for %.0f seconds...\n\n", ENTROPY_USER_SECONDS);
+    }
+
+    if (!collect_mouse_entropy(ENTROPY_USER_SECONDS, verbose)) {
+        fprintf(stderr, "Warning: mouse entropy collection had issues.\n");
+    }
+
+    if (verbose) printf("\nStrengthening with /dev/random...\n");
+    if (!seed_from_device("/dev/random", 32)) {
+        fprintf(stderr, "Warning: could not strengthen RNG from /dev/random.\n");
+    }
+
+    if (RAND_status() != 1) {
+        fprintf(stderr, "CSPRNG not properly seeded\n");
+        return 0;
+    }
+
+    if (verbose) printf("\n✓ RNG successfully seeded with user entropy!\n\n");
+    return 1;
+}
+
+static int start_reseeding(void) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&entropy_wake, &attr);
+    pthread_condattr_destroy(&attr);
+
+    stopping = 0;
+    if (pthread_create(&reseed_thread, NULL, reseed_main, NULL) != 0) {
+        pthread_cond_destroy(&entropy_wake);
+        return 0;
+    }
+    reseeding = 1;
+    return 1;
+}
+
+int entropy_start(int verbose) {
+    pthread_mutex_lock(&entropy_lock);
+    if (!seeded) seeded = seed_once(verbose);
+    if (seeded && !reseed_started) {
+        reseed_started = 1;
+        // the generator is seeded either way; only the periodic reseed is lost
+        if (!start_reseeding() || atexit(entropy_stop) != 0) {
+            fprintf(stderr, "Warning: could not start the RNG reseed thread\n");
+        }
+    }
+    int ok = seeded;
+    pthread_mutex_unlock(&entropy_lock);
+    return ok;
+}
+
+void entropy_stop(void) {
+    pthread_mutex_lock(&entropy_lock);
+    if (!reseeding) {
+        pthread_mutex_unlock(&entropy_lock);
+        return;
+    }
+    stopping = 1;
+    pthread_cond_signal(&entropy_wake);
+    pthread_mutex_unlock(&entropy_lock);
+
+    pthread_join(reseed_thread, NULL);
+    pthread_cond_destroy(&entropy_wake);
+
+    pthread_mutex_lock(&entropy_lock);
+    reseeding = 0;
+    pthread_mutex_unlock(&entropy_lock);
+}
+
+uint64_t entropy_reseed_count(void) {
+    pthread_mutex_lock(&entropy_lock);
+    uint64_t n = reseeds;
+    pthread_mutex_unlock(&entropy_lock);
+    return n;
+}
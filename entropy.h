@@ -0,0 +1,22 @@
+#ifndef ENTROPY_H
+#define ENTROPY_H
+
+#include <stdint.h>
+
+// process-wide seeding of OpenSSL's generator. the first entropy_start polls
+// the system, collects ENTROPY_USER_SECONDS of mouse/timing entropy and adds
+// /dev/random, then starts a thread that mixes fresh /dev/urandom output in
+// every ENTROPY_RESEED_SECONDS. every later call returns at once, so drawing
+// nonces and blinding factors costs no more than RAND_bytes
+#define ENTROPY_USER_SECONDS 5.0
+#define ENTROPY_RESEED_SECONDS 60
+
+// thread-safe; callers that arrive during the first seeding wait for it.
+// returns 1 once the generator is seeded. entropy_stop is registered with atexit
+int entropy_start(int verbose);
+// stops the reseed thread; the generator stays seeded
+void entropy_stop(void);
+// background reseeds done so far
+uint64_t entropy_reseed_count(void);
+
+#endif
@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <curl/curl.h>
+#include "mail_dispatch.h"
+
+#define MAX_IN_FLIGHT 64
+#define MAX_HOST_CONNECTIONS 16
+#define POLL_TIMEOUT_MS 1000
+#define REQUEST_TIMEOUT_SECONDS 30
+
+typedef struct MailJob {
+    struct MailJob *next;
+    char *json;
+    MailDoneFn done;
+    void *arg;
+} MailJob;
+
+struct MailDispatcher {
+    char *url;
+    struct curl_slist *headers;  // shared by every transfer
+    CURLM *multi;
+    CURLSH *share;  // only touched from the dispatcher thread, so it needs no lock callbacks
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    MailJob *head, *tail;  // waiting to be started
+    int stop;
+};
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int finished;
+    int status;
+} SyncSend;
+
+// escapes quotes, backslashes and control characters for a JSON string literal
+static size_t json_escape(char *out, const char *s) {
+    size_t n = 0;
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            if (out) {
+                out[n] = '\\';
+                out[n + 1] = (char)*p;
+            }
+            n += 2;
+        } else if (*p < 0x20) {
+            if (out) snprintf(out + n, 7, "\\u%04x", *p);
+            n += 6;
+        } else {
+            if (out) out[n] = (char)*p;
+            n++;
+        }
+    }
+    return n;
+}
+
+static char *build_json(const char *to, const char *subject, const char *text_body) {
+    const char *keys[3] = { "{\"to\":\"", "\",\"subject\":\"", "\",\"text_body\":\"" };
+    const char *values[3] = { to, subject, text_body };
+
+    size_t len = strlen("\"}") + 1;
+    for (int i = 0; i < 3; i++) len += strlen(keys[i]) + json_escape(NULL, values[i]);
+    char *json = malloc(len);
+    if (!json) return NULL;
+
+    size_t n = 0;
+    for (int i = 0; i < 3; i++) {
+        memcpy(json + n, keys[i], strlen(keys[i]));
+        n += strlen(keys[i]);
+        n += json_escape(json + n, values[i]);
+    }
+    memcpy(json + n, "\"}", 3);
+    return json;
+}
+
+static size_t discard_body(char *ptr, size_t size, size_t nmemb, void *userdata) {
+    (void)ptr;
+    (void)userdata;
+    return size * nmemb;
+}
+
+static int start_job(MailDispatcher *d, MailJob *job) {
+    CURL *easy = curl_easy_init();
+    if (!easy) return 0;
+
+    curl_easy_setopt(easy, CURLOPT_URL, d->url);
+    curl_easy_setopt(easy, CURLOPT_HTTPHEADER, d->headers);
+    curl_easy_setopt(easy, CURLOPT_POSTFIELDS, job->json);
+    curl_easy_setopt(easy, CURLOPT_SHARE, d->share);
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, discard_body);
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT, (long)REQUEST_TIMEOUT_SECONDS);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    // wait for an HTTP/2 connection to multiplex on rather than opening another
+    curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, job);
+
+    if (curl_multi_add_handle(d->multi, easy) != CURLM_OK) {
+        curl_easy_cleanup(easy);
+        return 0;
+    }
+    return 1;
+}
+
+static void finish_job(MailJob *job, int status) {
+    if (job->done) job->done(job->arg, status);
+    free(job->json);
+    free(job);
+}
+
+static void collect_finished(MailDispatcher *d, int *in_flight) {
+    CURLMsg *msg;
+    int left;
+    while ((msg = curl_multi_info_read(d->multi, &left))) {
+        if (msg->msg != CURLMSG_DONE) continue;
+
+        CURL *easy = msg->easy_handle;
+        MailJob *job = NULL;
+        curl_easy_getinfo(easy, CURLINFO_PRIVATE, (char **)&job);
+
+        int status = -1;
+        if (msg->data.result == CURLE_OK) {
+            long code = 0;
+            curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &code);
+            if (code == 200 || code == 202) {
+                status = 0;
+            } else {
+                fprintf(stderr, "Mail API returned HTTP %ld\n", code);
+            }
+        } else {
+            fprintf(stderr, "Mail request failed: %s\n", curl_easy_strerror(msg->data.result));
+        }
+
+        curl_multi_remove_handle(d->multi, easy);
+        curl_easy_cleanup(easy);
+        (*in_flight)--;
+        finish_job(job, status);
+    }
+}
+
+static void *dispatcher_main(void *arg) {
+    MailDispatcher *d = arg;
+    int in_flight = 0;
+
+    while (1) {
+        pthread_mutex_lock(&d->lock);
+        while (d->head && in_flight < MAX_IN_FLIGHT) {
+            MailJob *job = d->head;
+            d->head = job->next;
+            if (!d->head) d->tail = NULL;
+            pthread_mutex_unlock(&d->lock);
+
+            if (start_job(d, job)) {
+                in_flight++;
+            } else {
+                fprintf(stderr, "Failed to start mail request\n");
+                finish_job(job, -1);
+            }
+            pthread_mutex_lock(&d->lock);
+        }
+        int stopping = d->stop && !d->head;
+        pthread_mutex_unlock(&d->lock);
+
+        if (stopping && in_flight == 0) break;
+
+        int running;
+        curl_multi_perform(d->multi, &running);
+        collect_finished(d, &in_flight);
+        if (in_flight > 0 || !stopping) curl_multi_poll(d->multi, NULL, 0, POLL_TIMEOUT_MS, NULL);
+    }
+    return NULL;
+}
+
+MailDispatcher *mail_dispatcher_start(const char *url, const char *auth_token) {
+    MailDispatcher *d = calloc(1, sizeof(*d));
+    if (!d) return NULL;
+
+    char auth_header[1024];
+    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", auth_token);
+
+    d->url = strdup(url);
+    d->headers = curl_slist_append(NULL, "Content-Type: application/json");
+    struct curl_slist *with_auth = d->headers ? curl_slist_append(d->headers, auth_header) : NULL;
+    d->multi = curl_multi_init();
+    d->share = curl_share_init();
+    if (!d->url || !with_auth || !d->multi || !d->share) goto fail;
+    d->headers = with_auth;
+
+    curl_share_setopt(d->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(d->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_multi_setopt(d->multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)MAX_HOST_CONNECTIONS);
+    curl_multi_setopt(d->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+    pthread_mutex_init(&d->lock, NULL);
+    if (pthread_create(&d->thread, NULL, dispatcher_main, d) != 0) {
+        pthread_mutex_destroy(&d->lock);
+        goto fail;
+    }
+    return d;
+
+fail:
+    fprintf(stderr, "Failed to initialize mail dispatcher\n");
+    if (d->multi) curl_multi_cleanup(d->multi);
+    if (d->share) curl_share_cleanup(d->share);
+    curl_slist_free_all(d->headers);
+    free(d->url);
+    free(d);
+    return NULL;
+}
+
+void mail_dispatcher_stop(MailDispatcher *d) {
+    if (!d) return;
+
+    pthread_mutex_lock(&d->lock);
+    d->stop = 1;
+    pthread_mutex_unlock(&d->lock);
+    curl_multi_wakeup(d->multi);
+    pthread_join(d->thread, NULL);
+
+    pthread_mutex_destroy(&d->lock);
+    curl_multi_cleanup(d->multi);
+    curl_share_cleanup(d->share);
+    curl_slist_free_all(d->headers);
+    free(d->url);
+    free(d);
+}
+
+int mail_dispatcher_submit(MailDispatcher *d, const char *to, const char *subject,
+                           const char *text_body, MailDoneFn done, void *arg) {
+    MailJob *job = calloc(1, sizeof(*job));
+    if (!job) return 0;
+    job->json = build_json(to, subject, text_body);
+    if (!job->json) {
+        free(job);
+        return 0;
+    }
+    job->done = done;
+    job->arg = arg;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->tail) {
+        d->tail->next = job;
+    } else {
+        d->head = job;
+    }
+    d->tail = job;
+    pthread_mutex_unlock(&d->lock);
+
+    curl_multi_wakeup(d->multi);
+    return 1;
+}
+
+static void sync_send_done(void *arg, int status) {
+    SyncSend *s = arg;
+    pthread_mutex_lock(&s->lock);
+    s->status = status;
+    s->finished = 1;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+}
+
+int mail_dispatcher_send(MailDispatcher *d, const char *to, const char *subject, const char *text_body) {
+    SyncSend s = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, -1 };
+    if (!mail_dispatcher_submit(d, to, subject, text_body, sync_send_done, &s)) return -1;
+
+    pthread_mutex_lock(&s.lock);
+    while (!s.finished) pthread_cond_wait(&s.cond, &s.lock);
+    pthread_mutex_unlock(&s.lock);
+
+    pthread_cond_destroy(&s.cond);
+    pthread_mutex_destroy(&s.lock);
+    return s.status;
+}
@@ -0,0 +1,23 @@
+#ifndef MAIL_DISPATCH_H
+#define MAIL_DISPATCH_H
+
+// sends mail API requests from a queue on one background thread. all transfers
+// run on a single curl multi handle with a shared DNS and TLS session cache, so
+// connections and TLS sessions are reused and many sends are in flight at once
+typedef struct MailDispatcher MailDispatcher;
+
+// called on the dispatcher thread; status is 0 if the API accepted the mail
+typedef void (*MailDoneFn)(void *arg, int status);
+
+// url and bearer token of the mail API; both are copied
+MailDispatcher *mail_dispatcher_start(const char *url, const char *auth_token);
+// finishes everything already queued, then stops the thread
+void mail_dispatcher_stop(MailDispatcher *d);
+
+// queues one mail and returns at once; 0 if it could not be queued (done is not called)
+int mail_dispatcher_submit(MailDispatcher *d, const char *to, const char *subject,
+                           const char *text_body, MailDoneFn done, void *arg);
+// queues one mail and waits for the API's answer; returns 0 if it was accepted
+int mail_dispatcher_send(MailDispatcher *d, const char *to, const char *subject, const char *text_body);
+
+#endif
@@ -1,7 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <openssl/rand.h>
+#include <openssl/sha.h>
 #include "miller_rabin.h"
 #include "paillier.h"
 
@@ -122,6 +125,67 @@ u64 paillier_decrypt(u64 c, const Paillier_pub_key *pubKey, const Paillier_priv_
 	return m;
 }
 
+// the key file is one line "n g lambda l_u"; n^2 is recomputed on load
+int paillier_key_save(const char *path, const Paillier_pub_key *pubKey, const Paillier_priv_key *privKey) {
+	char tmp_path[4096];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+	// holds the private key, so never readable by others
+	int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	FILE *f = fd >= 0 ? fdopen(fd, "w") : NULL;
+	if (!f) {
+		perror("open paillier key");
+		if (fd >= 0) close(fd);
+		return 0;
+	}
+	int ok = fprintf(f, "%llu %llu %llu %llu\n", pubKey->n, pubKey->g, privKey->lambda, privKey->l_u) > 0;
+	if (fflush(f) != 0 || fsync(fileno(f)) != 0) ok = 0;
+	if (fclose(f) != 0) ok = 0;
+	if (!ok || rename(tmp_path, path) != 0) {
+		perror("write paillier key");
+		remove(tmp_path);
+		return 0;
+	}
+	return 1;
+}
+
+// 1 if loaded, 0 if the file is missing or malformed
+int paillier_key_load(const char *path, Paillier_pub_key *pubKey, Paillier_priv_key *privKey) {
+	FILE *f = fopen(path, "r");
+	if (!f) return 0;
+
+	u64 n, g, lambda, l_u;
+	int fields = fscanf(f, "%llu %llu %llu %llu", &n, &g, &lambda, &l_u);
+	fclose(f);
+	if (fields != 4 || n < 2 || n > 0xFFFFFFFFULL || g != n + 1) {
+		fprintf(stderr, "Malformed Paillier key file %s\n", path);
+		return 0;
+	}
+
+	pubKey->n = n;
+	pubKey->n_squared = n * n;
+	pubKey->g = g;
+	privKey->lambda = lambda;
+	privKey->l_u = l_u;
+	return 1;
+}
+
+// first 8 bytes of SHA-256 over (n, g), naming the key in checkpoints
+u64 paillier_key_id(const Paillier_pub_key *pubKey) {
+	unsigned char buf[16], digest[SHA256_DIGEST_LENGTH];
+	for (int i = 0; i < 8; i++) {
+		buf[i] = (unsigned char)(pubKey->n >> (56 - 8 * i));
+		buf[8 + i] = (unsigned char)(pubKey->g >> (56 - 8 * i));
+	}
+	SHA256(buf, sizeof(buf), digest);
+
+	u64 id = 0;
+	for (int i = 0; i < 8; i++) {
+		id = (id << 8) | digest[i];
+	}
+	return id;
+}
+
 u64 rand_u64() {
     unsigned char buf[8];
     if (RAND_bytes(buf, sizeof(buf)) != 1) {
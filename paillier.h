@@ -30,6 +30,10 @@ u64 paillier_encrypt(u64 m, u64 r, const Paillier_pub_key *pubKey);
 u64 paillier_decrypt(u64 c, const Paillier_pub_key *pubKey,
                      const Paillier_priv_key *privKey);
 
+int paillier_key_save(const char *path, const Paillier_pub_key *pubKey, const Paillier_priv_key *privKey);
+int paillier_key_load(const char *path, Paillier_pub_key *pubKey, Paillier_priv_key *privKey);
+u64 paillier_key_id(const Paillier_pub_key *pubKey);
+
 u64 rand_u64();
 u64 rand_range(u64 min, u64 max);
 u64 random_prime_in_range(u64 min, u64 max);
@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <string.h>
+#include "perfect_hash.h"
+
+#define KEYS_PER_BUCKET 2
+#define SPARE_SLOTS_DIVISOR 20  // 5% extra slots keep the last placements cheap
+#define MAX_SEED UINT32_MAX
+
+struct PerfectHash {
+    size_t n;
+    size_t slots;  // n plus spares; keys placed in a spare are remapped below n
+    size_t buckets;
+    uint32_t *seeds;  // per bucket: the displacement that sends its keys to free slots
+    uint32_t *remap;  // spare slot - n -> the free slot below n it stands for
+};
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// maps x uniformly onto [0, n) without a division
+static size_t reduce(uint64_t x, size_t n) {
+    return (size_t)(((unsigned __int128)x * n) >> 64);
+}
+
+static size_t slot_of(uint64_t hash, uint32_t seed, size_t n) {
+    return reduce(mix64(hash ^ ((uint64_t)seed * 0x9e3779b97f4a7c15ULL)), n);
+}
+
+static int taken(const uint64_t *bits, size_t i) {
+    return (bits[i / 64] >> (i % 64)) & 1;
+}
+
+// tries displacements until every key of the bucket lands on a distinct free slot
+static int place_bucket(const uint64_t *hashes, const uint32_t *keys, size_t k, size_t m,
+                        uint64_t *bits, uint32_t *seed_out) {
+    size_t slots[64];
+    if (k > 64) return 0;
+
+    for (size_t i = 0; i < k; i++) {
+        for (size_t j = 0; j < i; j++) {
+            if (hashes[keys[i]] == hashes[keys[j]]) return 0;
+        }
+    }
+
+    for (uint64_t seed = 0; seed <= MAX_SEED; seed++) {
+        size_t placed = 0;
+        for (; placed < k; placed++) {
+            size_t s = slot_of(hashes[keys[placed]], (uint32_t)seed, m);
+            if (taken(bits, s)) break;
+            size_t j = 0;
+            while (j < placed && slots[j] != s) j++;
+            if (j < placed) break;
+            slots[placed] = s;
+        }
+        if (placed < k) continue;
+
+        for (size_t i = 0; i < k; i++) bits[slots[i] / 64] |= 1ULL << (slots[i] % 64);
+        *seed_out = (uint32_t)seed;
+        return 1;
+    }
+    return 0;
+}
+
+PerfectHash *perfect_hash_build(const uint64_t *hashes, size_t n) {
+    PerfectHash *ph = calloc(1, sizeof(*ph));
+    if (!ph) return NULL;
+    ph->n = n;
+    ph->slots = n + n / SPARE_SLOTS_DIVISOR + 1;
+    ph->buckets = n / KEYS_PER_BUCKET + 1;
+    ph->seeds = calloc(ph->buckets, sizeof(uint32_t));
+    ph->remap = calloc(ph->slots - n, sizeof(uint32_t));
+
+    size_t nb = ph->buckets, m = ph->slots;
+    size_t *start = calloc(nb + 1, sizeof(size_t));
+    uint32_t *keys = malloc((n ? n : 1) * sizeof(uint32_t));
+    uint32_t *order = malloc(nb * sizeof(uint32_t));
+    uint64_t *bits = calloc(m / 64 + 1, sizeof(uint64_t));
+    size_t *fill = NULL, *by_size = NULL;
+    if (!ph->seeds || !ph->remap || !start || !keys || !order || !bits) goto fail;
+
+    // group keys by bucket
+    for (size_t i = 0; i < n; i++) start[reduce(hashes[i], nb) + 1]++;
+    size_t max_size = 0;
+    for (size_t b = 0; b < nb; b++) {
+        if (start[b + 1] > max_size) max_size = start[b + 1];
+        start[b + 1] += start[b];
+    }
+    fill = malloc(nb * sizeof(size_t));
+    by_size = calloc(max_size + 2, sizeof(size_t));
+    if (!fill || !by_size) goto fail;
+    memcpy(fill, start, nb * sizeof(size_t));
+    for (size_t i = 0; i < n; i++) keys[fill[reduce(hashes[i], nb)]++] = (uint32_t)i;
+
+    // biggest buckets first, while most slots are still free
+    for (size_t b = 0; b < nb; b++) by_size[max_size - (start[b + 1] - start[b]) + 1]++;
+    for (size_t s = 0; s <= max_size; s++) by_size[s + 1] += by_size[s];
+    for (size_t b = 0; b < nb; b++) order[by_size[max_size - (start[b + 1] - start[b])]++] = (uint32_t)b;
+
+    for (size_t i = 0; i < nb; i++) {
+        size_t b = order[i];
+        size_t k = start[b + 1] - start[b];
+        if (k == 0) break;
+        if (!place_bucket(hashes, keys + start[b], k, m, bits, &ph->seeds[b])) goto fail;
+    }
+
+    // exactly as many slots below n are free as spares are taken, so pair them up in order
+    size_t hole = 0;
+    for (size_t s = n; s < m; s++) {
+        if (!taken(bits, s)) continue;
+        while (taken(bits, hole)) hole++;
+        ph->remap[s - n] = (uint32_t)hole++;
+    }
+
+    free(start);
+    free(keys);
+    free(order);
+    free(bits);
+    free(fill);
+    free(by_size);
+    return ph;
+
+fail:
+    free(start);
+    free(keys);
+    free(order);
+    free(bits);
+    free(fill);
+    free(by_size);
+    perfect_hash_free(ph);
+    return NULL;
+}
+
+void perfect_hash_free(PerfectHash *ph) {
+    if (!ph) return;
+    free(ph->seeds);
+    free(ph->remap);
+    free(ph);
+}
+
+size_t perfect_hash_lookup(const PerfectHash *ph, uint64_t hash) {
+    size_t s = slot_of(hash, ph->seeds[reduce(hash, ph->buckets)], ph->slots);
+    return s < ph->n ? s : ph->remap[s - ph->n];
+}
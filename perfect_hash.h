@@ -0,0 +1,19 @@
+#ifndef PERFECT_HASH_H
+#define PERFECT_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// minimal perfect hash over a fixed set of distinct 64-bit key hashes
+// (hash and displace): every member maps to its own slot in [0, n) with one
+// seed load and a mix, and the tables cost about 2.2 bytes per key
+typedef struct PerfectHash PerfectHash;
+
+// NULL if two hashes are equal or memory runs out
+PerfectHash *perfect_hash_build(const uint64_t *hashes, size_t n);
+void perfect_hash_free(PerfectHash *ph);
+
+// slot of a member; non-members land on an arbitrary slot, so callers must compare keys
+size_t perfect_hash_lookup(const PerfectHash *ph, uint64_t hash);
+
+#endif
@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include "rate_limit.h"
+
+#define EMPTY_KEY 0
+#define ZERO_KEY_STANDIN 0x9e3779b97f4a7c15ULL  // stored in place of a key that mixes to 0
+
+typedef struct {
+    uint64_t key;  // mixed key; EMPTY_KEY until claimed
+    uint64_t tat;  // ms at which the bucket is full again; 0 means full
+} RateEntry;
+
+struct RateTable {
+    RateEntry *entries;
+    size_t mask;
+    uint64_t interval;
+    uint64_t window;  // burst * interval: how far ahead tat may run
+};
+
+// splitmix64 finalizer: a bijection, so distinct keys stay distinct
+static uint64_t mix_key(uint64_t k) {
+    k ^= k >> 30;
+    k *= 0xbf58476d1ce4e5b9ULL;
+    k ^= k >> 27;
+    k *= 0x94d049bb133111ebULL;
+    k ^= k >> 31;
+    return k == EMPTY_KEY ? ZERO_KEY_STANDIN : k;
+}
+
+RateTable *rate_table_create(size_t max_keys, RateLimit limit) {
+    if (limit.burst == 0 || limit.interval_ms == 0) return NULL;
+
+    // at most half full, so probes stay short
+    if (max_keys > SIZE_MAX / 4) return NULL;
+    size_t cap = 16;
+    while (cap < max_keys * 2) cap *= 2;
+
+    RateTable *t = malloc(sizeof(*t));
+    if (!t) return NULL;
+    t->entries = calloc(cap, sizeof(*t->entries));
+    if (!t->entries) {
+        free(t);
+        return NULL;
+    }
+    t->mask = cap - 1;
+    t->interval = limit.interval_ms;
+    t->window = (uint64_t)limit.burst * limit.interval_ms;
+    return t;
+}
+
+void rate_table_free(RateTable *t) {
+    if (!t) return;
+    free(t->entries);
+    free(t);
+}
+
+// finds or claims the entry for a mixed key; NULL once every slot belongs to another key
+static RateEntry *find_entry(RateTable *t, uint64_t key) {
+    size_t i = (size_t)key & t->mask;
+    for (size_t probes = 0; probes <= t->mask; probes++, i = (i + 1) & t->mask) {
+        RateEntry *e = &t->entries[i];
+        uint64_t seen = __atomic_load_n(&e->key, __ATOMIC_ACQUIRE);
+        if (seen == EMPTY_KEY) {
+            uint64_t expected = EMPTY_KEY;
+            if (__atomic_compare_exchange_n(&e->key, &expected, key, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                return e;
+            }
+            seen = expected;  // another thread claimed it first
+        }
+        if (seen == key) return e;
+    }
+    return NULL;
+}
+
+int rate_table_admit(RateTable *t, uint64_t key, uint64_t now_ms) {
+    RateEntry *e = find_entry(t, mix_key(key));
+    if (!e) return 0;
+
+    // a fresh entry has tat 0, which reads as a full bucket
+    uint64_t tat = __atomic_load_n(&e->tat, __ATOMIC_RELAXED);
+    while (1) {
+        uint64_t next = (tat > now_ms ? tat : now_ms) + t->interval;
+        if (next - now_ms > t->window) return 0;
+        if (__atomic_compare_exchange_n(&e->tat, &tat, next, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) return 1;
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef RATE_LIMIT_H
+#define RATE_LIMIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// token buckets keyed by a 64-bit key, in a fixed open-addressed table that is
+// safe to use from any number of threads without locks. each entry is the key
+// and one timestamp: the bucket is stored in GCRA form (the time at which it
+// will be full again), so taking a token is a single compare-and-swap
+typedef struct RateTable RateTable;
+
+typedef struct {
+    uint32_t burst;        // tokens in a full bucket
+    uint32_t interval_ms;  // one token comes back every interval
+} RateLimit;
+
+// room for max_keys distinct keys; entries are never removed
+RateTable *rate_table_create(size_t max_keys, RateLimit limit);
+void rate_table_free(RateTable *t);
+
+// takes one token for key; returns 1 if admitted, 0 if the bucket is empty or
+// the table has no room for a new key. now_ms must come from a monotonic clock
+int rate_table_admit(RateTable *t, uint64_t key, uint64_t now_ms);
+
+#endif
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "reg_snapshot.h"
+
+#define REG_SNAPSHOT_MAGIC "EVRS"
+#define REG_SNAPSHOT_VERSION 1
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t roster_size;
+    uint64_t elapsed_seconds;
+    unsigned char key_fp[REG_SNAPSHOT_FINGERPRINT_BYTES];
+    unsigned char roster_fp[REG_SNAPSHOT_FINGERPRINT_BYTES];
+} SnapshotHeader;
+
+struct RegSnapshot {
+    int fd;
+    unsigned char *map;
+    size_t map_len;
+    SnapshotHeader *header;
+    unsigned char *bits;
+    size_t page_size;
+};
+
+static size_t snapshot_len(size_t roster_size) {
+    return sizeof(SnapshotHeader) + (roster_size + 7) / 8;
+}
+
+static int header_matches(const SnapshotHeader *h, size_t roster_size,
+                          const unsigned char *key_fp, const unsigned char *roster_fp) {
+    return memcmp(h->magic, REG_SNAPSHOT_MAGIC, 4) == 0 &&
+           h->version == REG_SNAPSHOT_VERSION &&
+           h->roster_size == roster_size &&
+           memcmp(h->key_fp, key_fp, REG_SNAPSHOT_FINGERPRINT_BYTES) == 0 &&
+           memcmp(h->roster_fp, roster_fp, REG_SNAPSHOT_FINGERPRINT_BYTES) == 0;
+}
+
+// msync wants page-aligned ranges
+static int sync_range(RegSnapshot *snap, const void *addr, size_t len, int flags) {
+    size_t off = (size_t)((const unsigned char *)addr - snap->map);
+    size_t start = off & ~(snap->page_size - 1);
+    return msync(snap->map + start, off + len - start, flags) == 0;
+}
+
+RegSnapshot *reg_snapshot_open(const char *path, size_t roster_size,
+                               const unsigned char key_fp[REG_SNAPSHOT_FINGERPRINT_BYTES],
+                               const unsigned char roster_fp[REG_SNAPSHOT_FINGERPRINT_BYTES],
+                               int *resumed) {
+    RegSnapshot *snap = calloc(1, sizeof(*snap));
+    if (!snap) return NULL;
+
+    snap->page_size = (size_t)sysconf(_SC_PAGESIZE);
+    snap->map_len = snapshot_len(roster_size);
+    snap->fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (snap->fd < 0) {
+        perror("open registration snapshot");
+        free(snap);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(snap->fd, &st) != 0) goto fail;
+
+    *resumed = 0;
+    if ((size_t)st.st_size == snap->map_len) {
+        SnapshotHeader h;
+        if (pread(snap->fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) &&
+            header_matches(&h, roster_size, key_fp, roster_fp)) {
+            *resumed = 1;
+        }
+    }
+
+    if (!*resumed) {
+        // different key, roster or layout: the old progress does not apply
+        if (ftruncate(snap->fd, 0) != 0 || ftruncate(snap->fd, (off_t)snap->map_len) != 0) goto fail;
+    }
+
+    snap->map = mmap(NULL, snap->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, snap->fd, 0);
+    if (snap->map == MAP_FAILED) {
+        perror("mmap registration snapshot");
+        snap->map = NULL;
+        goto fail;
+    }
+    snap->header = (SnapshotHeader *)snap->map;
+    snap->bits = snap->map + sizeof(SnapshotHeader);
+
+    if (!*resumed) {
+        memcpy(snap->header->magic, REG_SNAPSHOT_MAGIC, 4);
+        snap->header->version = REG_SNAPSHOT_VERSION;
+        snap->header->roster_size = roster_size;
+        memcpy(snap->header->key_fp, key_fp, REG_SNAPSHOT_FINGERPRINT_BYTES);
+        memcpy(snap->header->roster_fp, roster_fp, REG_SNAPSHOT_FINGERPRINT_BYTES);
+        if (msync(snap->map, snap->map_len, MS_SYNC) != 0) goto fail;
+    }
+    return snap;
+
+fail:
+    reg_snapshot_close(snap);
+    return NULL;
+}
+
+void reg_snapshot_close(RegSnapshot *snap) {
+    if (!snap) return;
+    if (snap->map) {
+        msync(snap->map, snap->map_len, MS_SYNC);
+        munmap(snap->map, snap->map_len);
+    }
+    close(snap->fd);
+    free(snap);
+}
+
+int reg_snapshot_is_issued(const RegSnapshot *snap, size_t index) {
+    if (index >= snap->header->roster_size) return 0;
+    return (snap->bits[index / 8] >> (index % 8)) & 1;
+}
+
+int reg_snapshot_mark_issued(RegSnapshot *snap, size_t index) {
+    if (index >= snap->header->roster_size) return 0;
+    snap->bits[index / 8] |= (unsigned char)(1u << (index % 8));
+    return sync_range(snap, &snap->bits[index / 8], 1, MS_SYNC);
+}
+
+uint64_t reg_snapshot_elapsed(const RegSnapshot *snap) {
+    return snap->header->elapsed_seconds;
+}
+
+void reg_snapshot_set_elapsed(RegSnapshot *snap, uint64_t seconds) {
+    if (snap->header->elapsed_seconds == seconds) return;
+    snap->header->elapsed_seconds = seconds;
+    sync_range(snap, &snap->header->elapsed_seconds, sizeof(seconds), MS_ASYNC);
+}
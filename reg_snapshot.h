@@ -0,0 +1,31 @@
+#ifndef REG_SNAPSHOT_H
+#define REG_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define REG_SNAPSHOT_FINGERPRINT_BYTES 32
+
+// registration progress that survives a restart: one bit per roster index for
+// "token issued" and the seconds of the registration window already used,
+// bound to the signing key and the roster it was taken with. the file is
+// mmap'd, so resuming costs one open and marking a student one bit and an msync
+typedef struct RegSnapshot RegSnapshot;
+
+// resumes the snapshot at path when its key and roster fingerprints match,
+// otherwise starts an empty one; *resumed tells which happened
+RegSnapshot *reg_snapshot_open(const char *path, size_t roster_size,
+                               const unsigned char key_fp[REG_SNAPSHOT_FINGERPRINT_BYTES],
+                               const unsigned char roster_fp[REG_SNAPSHOT_FINGERPRINT_BYTES],
+                               int *resumed);
+void reg_snapshot_close(RegSnapshot *snap);
+
+int reg_snapshot_is_issued(const RegSnapshot *snap, size_t index);
+// sets the bit and syncs its page before returning; 0 on error
+int reg_snapshot_mark_issued(RegSnapshot *snap, size_t index);
+
+uint64_t reg_snapshot_elapsed(const RegSnapshot *snap);
+// cheap enough to call every loop iteration; flushed asynchronously
+void reg_snapshot_set_elapsed(RegSnapshot *snap, uint64_t seconds);
+
+#endif
@@ -2,15 +2,48 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <time.h>
+#include <stddef.h>
 #include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
 #include <openssl/bn.h>
 #include <curl/curl.h>
 #include "rsa.h"
 #include "token_generation.h"
 #include "authentication.h"
+#include "wire.h"
+#include "token_store.h"
+#include "token_registry.h"
+#include "token_appender.h"
+#include "shm_token_table.h"
+#include "reg_snapshot.h"
+#include "roster.h"
+#include "timer_wheel.h"
+#include "rate_limit.h"
+#include "entropy.h"
+#include "token_hash.h"
 
 #define VOTING_DURATION_SECONDS (2 * 60)
-#define NUM_STUDENTS 38
+#define NUM_STUDENTS ((int)(sizeof(STUDENT_IDS) / sizeof(STUDENT_IDS[0])))
+#define CLIENT_TIMEOUT_SECONDS 120
+#define TOKEN_STORE_FILE "tokens.bin"
+#define TOKEN_STAGE_FILE "tokens.stage"
+#define TOKENS_TXT_FILE "tokens.txt"
+#define TOKEN_SYNC_WINDOW_MS 1000
+#define TOKEN_BATCH_BUFFER_RECORDS 1024
+#define BATCH_AUDIT_CHUNK 4096
+#define MAX_BATCH_TOKENS 100000000ULL  // the registry and shared table are sized from it up front
+#define RSA_KEY_FILE "rsa.key"
+#define REG_SNAPSHOT_FILE "registration.snap"
+#define ROSTER_FILE "roster.csv"
+#define ID_CODE_BURST 3                      // codes one student can ask for back to back
+#define ID_CODE_INTERVAL_MS (2 * 60 * 1000)  // then one more every two minutes
+#define SOURCE_BURST 100                     // requests one client user can make back to back
+#define SOURCE_INTERVAL_MS 50
+#define MAX_SOURCES 4096
 
 BIGNUM *g_public_n = NULL;
 BIGNUM *g_public_e = NULL;
@@ -96,75 +129,138 @@ static const char *STUDENT_MAILS[] = {
     "sabrahamyan@aua.am",
 };
 
-static char *token_registry[NUM_STUDENTS] = {NULL};
+// every token hash issued by this run, to refuse duplicate commits
+static TokenRegistry *token_registry = NULL;
+
+// tokens.txt for the voting system and the stage for the binary token store,
+// both kept open for the whole run
+static TokenAppender *tokens_txt_out = NULL;
+static TokenAppender *token_stage_out = NULL;
+
+// issued tokens published to voting processes through shared memory, if available
+static ShmTokenTable *token_table = NULL;
+
+// which students already hold a token and how much of the window is used, across restarts
+static RegSnapshot *reg_snapshot = NULL;
 
 static void free_keys(void) {
+    token_generation_cleanup();
     if (g_public_n) BN_free(g_public_n);
     if (g_public_e) BN_free(g_public_e);
     if (s_private_d) BN_free(s_private_d);
     g_public_n = g_public_e = s_private_d = NULL;
 }
 
-int register_token(const char *token_hex) {
-    if (!token_hex || !token_hex[0]) return 0;
-    for (int i = 0; i < NUM_STUDENTS; i++) {
-        if (token_registry[i] == NULL) {
-            token_registry[i] = strdup(token_hex);
-            return token_registry[i] != NULL;
-        }
+static int hex_to_key(const char *hex, unsigned char key[TOKEN_STORE_KEY_BYTES]) {
+    if (strlen(hex) != TOKEN_STORE_KEY_BYTES * 2) return 0;
+    for (int i = 0; i < TOKEN_STORE_KEY_BYTES; i++) {
+        unsigned int byte;
+        if (sscanf(hex + 2 * i, "%2x", &byte) != 1) return 0;
+        key[i] = (unsigned char)byte;
     }
-    return 0;
+    return 1;
+}
+
+// 1 if newly registered, 0 if malformed or already registered, -1 on allocation failure
+int register_token(const char *token_hex) {
+    unsigned char key[TOKEN_REGISTRY_KEY_BYTES];
+    if (!token_hex || !hex_to_key(token_hex, key)) return 0;
+    return token_registry_insert(token_registry, key);
 }
 
 int use_token(const char *token_hex) {
-    if (!token_hex || !token_hex[0]) return 0;
-    for (int i = 0; i < NUM_STUDENTS; i++) {
-        if (token_registry[i] && strcmp(token_registry[i], token_hex) == 0) {
-            free(token_registry[i]);
-            token_registry[i] = NULL;
-            return 1;
-        }
+    unsigned char key[TOKEN_REGISTRY_KEY_BYTES];
+    if (!token_hex || !hex_to_key(token_hex, key)) return 0;
+    return token_registry_remove(token_registry, key);
+}
+
+static int open_token_outputs(const TokenAppendPolicy *policy) {
+    tokens_txt_out = token_appender_open(TOKENS_TXT_FILE, TOKEN_APPEND_HEX, policy);
+    token_stage_out = token_appender_open(TOKEN_STAGE_FILE, TOKEN_APPEND_BINARY, policy);
+    if (!tokens_txt_out || !token_stage_out) {
+        fprintf(stderr, "ERROR: Failed to open %s or %s for writing\n", TOKENS_TXT_FILE, TOKEN_STAGE_FILE);
+        return 0;
+    }
+    return 1;
+}
+
+// runs before merge_token_store so the stage is complete when it is merged
+static void close_token_outputs(void) {
+    if (!token_appender_close(tokens_txt_out) || !token_appender_close(token_stage_out)) {
+        fprintf(stderr, "WARNING: issued tokens may not have reached disk\n");
+    }
+    tokens_txt_out = token_stage_out = NULL;
+}
+
+// writes the token to tokens.txt and the store stage, or to neither
+static int append_token_outputs(const unsigned char key[TOKEN_STORE_KEY_BYTES]) {
+    if (!token_appender_add(tokens_txt_out, key)) return 0;
+    if (token_appender_add(token_stage_out, key)) return 1;
+    if (!token_appender_drop_last(tokens_txt_out)) {
+        fprintf(stderr, "WARNING: %s now lists a token missing from %s\n", TOKENS_TXT_FILE, TOKEN_STAGE_FILE);
     }
     return 0;
 }
 
+static void publish_token(const unsigned char key[TOKEN_STORE_KEY_BYTES]) {
+    if (token_table && shm_token_table_insert(token_table, key) < 0) {
+        fprintf(stderr, "WARNING: shared token table is full, voting will find this token in %s\n", TOKENS_TXT_FILE);
+    }
+}
+
+static void create_token_table(size_t expected) {
+    unsigned char fingerprint[SHM_TOKEN_FINGERPRINT_BYTES];
+    if (shm_token_table_fingerprint(g_public_n, fingerprint)) {
+        // a restart with the same key keeps publishing into the existing table
+        token_table = shm_token_table_attach(SHM_TOKEN_TABLE_NAME, fingerprint);
+        if (!token_table) token_table = shm_token_table_create(SHM_TOKEN_TABLE_NAME, expected, fingerprint);
+    }
+    if (!token_table) {
+        fprintf(stderr, "WARNING: no shared token table, voting will read %s\n", TOKENS_TXT_FILE);
+    }
+}
+
 static int write_token_immediately(const char *token_hex) {
-    if (!token_hex || !token_hex[0]) {
+    unsigned char key[TOKEN_STORE_KEY_BYTES];
+    if (!token_hex || !hex_to_key(token_hex, key)) {
         fprintf(stderr, "Invalid token provided for writing\n");
         return 0;
     }
 
-    FILE *f = fopen("tokens.txt", "a");
-    if (!f) {
-        fprintf(stderr, "ERROR: Failed to open tokens.txt for writing\n");
-        perror("fopen");
+    int registered = token_registry_insert(token_registry, key);
+    if (registered == 0) {
+        fprintf(stderr, "ERROR: Token is already registered\n");
         return 0;
     }
-
-    if (fprintf(f, "%s\n", token_hex) < 0) {
-        fprintf(stderr, "ERROR: Failed to write token to file\n");
-        fclose(f);
+    if (registered < 0) {
+        fprintf(stderr, "ERROR: Out of memory registering token\n");
         return 0;
     }
 
-    if (fflush(f) != 0) {
-        fprintf(stderr, "WARNING: Failed to flush token to disk\n");
+    if (!append_token_outputs(key)) {
+        fprintf(stderr, "ERROR: Failed to write token to %s\n", TOKENS_TXT_FILE);
+        token_registry_remove(token_registry, key);
+        return 0;
     }
+    publish_token(key);
 
-    fclose(f);
     printf("Token written to tokens.txt\n");
     return 1;
 }
 
-static void cleanup_token_registry(void) {
-    for (int i = 0; i < NUM_STUDENTS; i++) {
-        if (token_registry[i]) {
-            free(token_registry[i]);
-            token_registry[i] = NULL;
-        }
+static void merge_token_store(void) {
+    if (!token_store_merge(TOKEN_STORE_FILE, TOKEN_STAGE_FILE)) {
+        fprintf(stderr, "WARNING: staged tokens were not merged into %s\n", TOKEN_STORE_FILE);
     }
 }
 
+static void cleanup_token_registry(void) {
+    token_registry_free(token_registry);
+    token_registry = NULL;
+    shm_token_table_detach(token_table);
+    token_table = NULL;
+}
+
 int system_blind_sign(const BIGNUM *m_blinded, BIGNUM **s_blinded_out) {
     if (!m_blinded || !s_private_d || !g_public_n || !s_blinded_out) return 0;
 
@@ -188,20 +284,693 @@ int system_blind_sign(const BIGNUM *m_blinded, BIGNUM **s_blinded_out) {
     return 1;
 }
 
-int main(void) {
-    if (atexit(cleanup_token_registry) != 0) {
+// appends every token hash from a batch file to tokens.txt and the store stage
+// through the buffered appenders, syncing once at the end. records are read in
+// chunks and each chunk is audited first: every token hash must be
+// SHA256(ELECTION_ID || nonce), recomputed on the multi-buffer path
+static int register_batch_tokens(FILE *batch) {
+    uint64_t count;
+    uint32_t sig_len;
+    if (!token_batch_read_header(batch, &count, &sig_len)) {
+        fprintf(stderr, "Invalid batch file header\n");
+        return 0;
+    }
+
+    unsigned char *sig = malloc(sig_len);
+    unsigned char *nonces = malloc(BATCH_AUDIT_CHUNK * TOKEN_BATCH_NONCE_BYTES);
+    unsigned char *hashes = malloc(BATCH_AUDIT_CHUNK * TOKEN_BATCH_HASH_BYTES);
+    int ok = sig && nonces && hashes;
+    if (!ok) fprintf(stderr, "Out of memory reading the batch file\n");
+
+    for (uint64_t done = 0; ok && done < count; ) {
+        size_t n = count - done < BATCH_AUDIT_CHUNK ? (size_t)(count - done) : BATCH_AUDIT_CHUNK;
+        for (size_t i = 0; i < n; i++) {
+            if (!token_batch_read_record(batch, sig_len, nonces + i * TOKEN_BATCH_NONCE_BYTES,
+                                         hashes + i * TOKEN_BATCH_HASH_BYTES, sig)) {
+                fprintf(stderr, "Truncated batch file at record %llu\n", (unsigned long long)(done + i));
+                ok = 0;
+                n = i;
+                break;
+            }
+        }
+
+        size_t first_bad = 0;
+        size_t bad = token_hash_verify_many(nonces, hashes, n, &first_bad);
+        if (bad > 0) {
+            fprintf(stderr, "ERROR: %zu batch records fail the token hash audit, first at record %llu; "
+                            "nothing from record %llu on is registered\n",
+                    bad, (unsigned long long)(done + first_bad), (unsigned long long)done);
+            ok = 0;
+            break;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            const unsigned char *token_hash = hashes + i * TOKEN_BATCH_HASH_BYTES;
+            if (token_registry_insert(token_registry, token_hash) != 1) {
+                fprintf(stderr, "Warning: batch record %llu repeats an issued token\n", (unsigned long long)(done + i));
+            }
+            if (!append_token_outputs(token_hash)) {
+                fprintf(stderr, "ERROR: Failed to write tokens.txt\n");
+                ok = 0;
+                break;
+            }
+            publish_token(token_hash);
+        }
+        done += n;
+    }
+
+    if (!token_appender_sync(tokens_txt_out) || !token_appender_sync(token_stage_out)) {
+        fprintf(stderr, "ERROR: Failed to sync issued tokens\n");
+        ok = 0;
+    }
+    free(sig);
+    free(nonces);
+    free(hashes);
+    return ok;
+}
+
+// digits only: strtoull would take "-1" as a huge count and saturate on overflow
+static int parse_batch_count(const char *str, size_t *count_out) {
+    if (*str < '0' || *str > '9') return 0;
+    errno = 0;
+    char *end = NULL;
+    unsigned long long count = strtoull(str, &end, 10);
+    if (errno != 0 || *end != '\0' || count == 0 || count > MAX_BATCH_TOKENS) return 0;
+    *count_out = (size_t)count;
+    return 1;
+}
+
+static int run_batch_issuance(size_t count, const char *out_path) {
+    FILE *out = fopen(out_path, "w+b");
+    if (!out) {
+        perror("fopen");
+        return EXIT_FAILURE;
+    }
+
+    if (run_token_generation_batch(g_public_n, g_public_e, count, out) != 0) {
+        fclose(out);
+        return EXIT_FAILURE;
+    }
+
+    rewind(out);
+    int ok = register_batch_tokens(out);
+    fclose(out);
+    if (!ok) return EXIT_FAILURE;
+
+    printf("%zu tokens written to %s, audited (%s SHA-256) and registered in tokens.txt\n",
+           count, out_path, token_hash_backend());
+    return EXIT_SUCCESS;
+}
+
+// the signing key persists so a restarted registration keeps issuing for the same election
+static int load_or_generate_keys(void) {
+    if (rsa_load_keypair(RSA_KEY_FILE, &g_public_n, &g_public_e, &s_private_d)) {
+        printf("RSA key loaded from %s.\n", RSA_KEY_FILE);
+        return 1;
+    }
+    if (!rsa_generate_keypair(&g_public_n, &g_public_e, &s_private_d, 2048)) return 0;
+    return rsa_save_keypair(RSA_KEY_FILE, g_public_n, g_public_e, s_private_d);
+}
+
+// an invalid row is skipped, running out of memory stops the load
+static int add_roster_row(const char *id, const char *email, void *arg) {
+    (void)arg;
+    int rc = auth_add_student(id, email);
+    return rc == 0 ? 1 : rc < 0 ? -1 : 0;
+}
+
+// streams ROSTER_FILE when present, otherwise falls back to the built-in class list
+static int load_roster(void) {
+    if (access(ROSTER_FILE, F_OK) != 0) {
+        for (int i = 0; i < NUM_STUDENTS; i++) {
+            if (auth_add_student(STUDENT_IDS[i], STUDENT_MAILS[i]) != 0) {
+                fprintf(stderr, "Failed to add student %s\n", STUDENT_IDS[i]);
+                return 0;
+            }
+        }
+        return 1;
+    }
+
+    RosterStats stats;
+    if (!roster_load(ROSTER_FILE, add_roster_row, NULL, &stats)) {
+        fprintf(stderr, "Failed to load roster %s\n", ROSTER_FILE);
+        return 0;
+    }
+    double secs = stats.seconds > 0 ? stats.seconds : 1e-9;
+    printf("Roster %s: %zu students (%zu rows skipped), %.1f MiB in %.3f s, %.0f rows/s, %.1f MiB/s\n",
+           ROSTER_FILE, stats.rows, stats.skipped, stats.bytes / 1048576.0, stats.seconds,
+           stats.rows / secs, stats.bytes / 1048576.0 / secs);
+    if (stats.rows == 0) {
+        fprintf(stderr, "Roster %s has no students\n", ROSTER_FILE);
+        return 0;
+    }
+    return 1;
+}
+
+// restores token_generated flags from the snapshot; returns the seconds of the window already used
+static uint64_t open_reg_snapshot(void) {
+    unsigned char key_fp[SHM_TOKEN_FINGERPRINT_BYTES], roster_fp[REG_SNAPSHOT_FINGERPRINT_BYTES];
+    if (!shm_token_table_fingerprint(g_public_n, key_fp) || !auth_roster_fingerprint(roster_fp)) return 0;
+
+    int resumed = 0;
+    reg_snapshot = reg_snapshot_open(REG_SNAPSHOT_FILE, (size_t)auth_get_student_count(), key_fp, roster_fp, &resumed);
+    if (!reg_snapshot) {
+        fprintf(stderr, "WARNING: no registration snapshot, a restart will not remember issued tokens\n");
+        return 0;
+    }
+    if (!resumed) return 0;
+
+    int issued = 0;
+    for (int i = 0; i < auth_get_student_count(); i++) {
+        if (reg_snapshot_is_issued(reg_snapshot, (size_t)i)) {
+            auth_mark_token_generated(i);
+            issued++;
+        }
+    }
+    uint64_t elapsed = reg_snapshot_elapsed(reg_snapshot);
+    printf("Resumed registration: %d students already have tokens, %llu seconds of the window used.\n",
+           issued, (unsigned long long)elapsed);
+    return elapsed;
+}
+
+static void close_reg_snapshot(void) {
+    reg_snapshot_close(reg_snapshot);
+    reg_snapshot = NULL;
+}
+
+static RateTable *id_limits = NULL;
+static RateTable *source_limits = NULL;
+
+static int open_admission(void) {
+    int students = auth_get_student_count();
+    id_limits = rate_table_create(students > 0 ? (size_t)students : 1, (RateLimit){ ID_CODE_BURST, ID_CODE_INTERVAL_MS });
+    source_limits = rate_table_create(MAX_SOURCES, (RateLimit){ SOURCE_BURST, SOURCE_INTERVAL_MS });
+    if (!id_limits || !source_limits) {
+        fprintf(stderr, "Failed to allocate rate limit tables\n");
+        return 0;
+    }
+    return 1;
+}
+
+static void free_admission(void) {
+    rate_table_free(id_limits);
+    rate_table_free(source_limits);
+    id_limits = NULL;
+    source_limits = NULL;
+}
+
+// admission control in front of authentication: a request turned away here never
+// reaches the mailer or the signer. source is the client's uid, NULL on the console
+static int admit_code_request(const char *student_id, const uint32_t *source) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now_ms = (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+
+    if (source && !rate_table_admit(source_limits, *source, now_ms)) return 0;
+    // unknown IDs cost authentication nothing, so they take no entry in the ID table
+    int student = auth_find_student(student_id);
+    return student < 0 || rate_table_admit(id_limits, (uint64_t)student, now_ms);
+}
+
+// returns 0 if the student already had a token
+static int mark_token_generated(int student) {
+    if (!auth_mark_token_generated(student)) return 0;
+    if (reg_snapshot && !reg_snapshot_mark_issued(reg_snapshot, (size_t)student)) {
+        fprintf(stderr, "WARNING: failed to record issued token for %s in %s\n",
+                auth_student_id(student), REG_SNAPSHOT_FILE);
+    }
+    return 1;
+}
+
+// returns 1 and prints the reason once registration must stop
+static int registration_closed(time_t start_time) {
+    time_t now = time(NULL);
+    if (now == (time_t)-1) {
+        fprintf(stderr, "time() failed.\n");
+        return 1;
+    }
+
+    auth_expire_codes(now);
+
+    double elapsed = difftime(now, start_time);
+    if (reg_snapshot && elapsed >= 0) reg_snapshot_set_elapsed(reg_snapshot, (uint64_t)elapsed);
+    if (elapsed >= VOTING_DURATION_SECONDS) {
+        printf("\nTime limit (%d minutes) reached. Registration is now closed.\n", VOTING_DURATION_SECONDS/60);
+        return 1;
+    }
+
+    if (auth_all_tokens_generated()) {
+        printf("\nAll students in the list have generated their tokens. Registration is now closed.\n");
+        return 1;
+    }
+    return 0;
+}
+
+// --listen serves every token_client session from one epoll loop. each session
+// is a small state machine, so a student who is slow to type the code, or a
+// mail that is slow to go out, never holds up anyone else
+typedef enum {
+    SESSION_WAIT_ID,
+    SESSION_SENDING_CODE,  // verification mail queued, waiting for the API
+    SESSION_WAIT_CODE,
+    SESSION_WAIT_BLIND,
+    SESSION_WAIT_COMMIT,
+    SESSION_CLOSING,       // last reply queued, close once it is written
+} SessionState;
+
+typedef struct {
+    WireConn conn;
+    int active;
+    uint16_t generation;  // tells a mail result for an earlier session in this slot apart
+    uint32_t events;      // current epoll interest
+    SessionState state;
+    TimerNode timer;      // idle deadline
+    size_t slot;
+    uint32_t source;      // peer uid, for admission control
+    int student;
+    char student_id[ID_SIZE];
+} Session;
+
+typedef struct {
+    uint32_t slot;
+    uint16_t generation;
+    int status;
+} MailResult;
+
+#define SERVER_TAG_LISTEN 0
+#define SERVER_TAG_MAIL 1
+#define SERVER_TAG_SESSION 2  // session slot i is tagged SERVER_TAG_SESSION + i
+#define SERVER_MAX_EVENTS 256
+
+typedef struct {
+    int epoll_fd;
+    int listen_fd;
+    int listen_paused;  // out of descriptors; resumes when a session closes
+    Session **sessions;
+    size_t session_cap;
+    size_t *free_slots;
+    size_t free_count;
+    size_t active;
+    TimerWheel timers;  // one idle timeout per session, in seconds
+} SessionServer;
+
+static int mail_pipe[2] = { -1, -1 };
+
+// runs on the mail thread; a full pipe only costs that session its timeout
+static void session_mail_done(void *arg, int status) {
+    uintptr_t tag = (uintptr_t)arg;
+    MailResult r = { (uint32_t)(tag >> 16), (uint16_t)(tag & 0xffff), status };
+    if (write(mail_pipe[1], &r, sizeof(r)) != (ssize_t)sizeof(r)) {
+        fprintf(stderr, "WARNING: mail result dropped for session %u\n", r.slot);
+    }
+}
+
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static void close_session(SessionServer *srv, size_t slot) {
+    Session *s = srv->sessions[slot];
+    timer_wheel_remove(&srv->timers, &s->timer);
+    epoll_ctl(srv->epoll_fd, EPOLL_CTL_DEL, s->conn.fd, NULL);
+    close(s->conn.fd);
+    wire_conn_free(&s->conn);
+    s->active = 0;
+    s->generation++;
+    srv->free_slots[srv->free_count++] = slot;
+    srv->active--;
+
+    if (srv->listen_paused) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.u64 = SERVER_TAG_LISTEN };
+        if (epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, srv->listen_fd, &ev) == 0) srv->listen_paused = 0;
+    }
+}
+
+static void session_fail(Session *s, uint8_t status, const char *msg) {
+    wire_conn_queue_status(&s->conn, status, msg);
+    s->state = SESSION_CLOSING;
+}
+
+// writes what it can, then matches the epoll interest to what the session waits for
+static void session_update(SessionServer *srv, size_t slot) {
+    Session *s = srv->sessions[slot];
+    int flushed = wire_conn_flush(&s->conn);
+    if (flushed < 0 || (flushed == 1 && s->state == SESSION_CLOSING)) {
+        close_session(srv, slot);
+        return;
+    }
+
+    uint32_t events = (s->state == SESSION_CLOSING ? 0 : EPOLLIN) | (flushed == 0 ? EPOLLOUT : 0);
+    if (events != s->events) {
+        struct epoll_event ev = { .events = events, .data.u64 = SERVER_TAG_SESSION + slot };
+        epoll_ctl(srv->epoll_fd, EPOLL_CTL_MOD, s->conn.fd, &ev);
+        s->events = events;
+    }
+}
+
+static void session_on_id(Session *s, size_t slot, const unsigned char *payload, uint32_t len) {
+    if (len == 0 || len >= sizeof(s->student_id)) {
+        session_fail(s, WIRE_STATUS_FAIL, "Invalid student ID");
+        return;
+    }
+    memcpy(s->student_id, payload, len);
+    s->student_id[len] = '\0';
+
+    if (!admit_code_request(s->student_id, &s->source)) {
+        printf("Too many verification requests for student ID %s, request refused.\n\n", s->student_id);
+        session_fail(s, WIRE_STATUS_FAIL, "Too many verification requests. Please try again later.");
+        return;
+    }
+
+    void *tag = (void *)(((uintptr_t)slot << 16) | s->generation);
+    int auth_result = auth_send_code_async(s->student_id, session_mail_done, tag);
+    if (auth_result == 2) {
+        session_fail(s, WIRE_STATUS_ALREADY_ISSUED, "Token for this student ID has already been generated");
+    } else if (auth_result != 0) {
+        session_fail(s, WIRE_STATUS_FAIL, "Verification failed");
+    } else {
+        s->student = auth_find_student(s->student_id);
+        s->state = SESSION_SENDING_CODE;
+    }
+}
+
+static void session_on_code(Session *s, const unsigned char *payload, uint32_t len) {
+    AuthCodeResult result = auth_check_code(s->student, (const char *)payload, len);
+    if (result != AUTH_CODE_OK) {
+        printf("Worng verification code\n\n");
+        // NONE here means the wheel already dropped the code
+        int expired = result == AUTH_CODE_EXPIRED || result == AUTH_CODE_NONE;
+        session_fail(s, WIRE_STATUS_FAIL, expired ? "Verification code expired" : "Wrong verification code");
+        return;
+    }
+    wire_conn_queue_status(&s->conn, WIRE_STATUS_OK, "Verification successful.");
+    s->state = SESSION_WAIT_BLIND;
+}
+
+static void session_on_blind(Session *s, const unsigned char *payload, uint32_t len) {
+    BIGNUM *m_blinded = BN_bin2bn(payload, (int)len, NULL);
+    if (!m_blinded || BN_cmp(m_blinded, g_public_n) >= 0) {
+        BN_free(m_blinded);
+        session_fail(s, WIRE_STATUS_FAIL, "Invalid blinded token");
+        return;
+    }
+
+    BIGNUM *s_blinded = NULL;
+    int signed_ok = system_blind_sign(m_blinded, &s_blinded);
+    BN_free(m_blinded);
+    if (!signed_ok) {
+        session_fail(s, WIRE_STATUS_FAIL, "Signing failed");
+        return;
+    }
+
+    // one signature per student, even if the client never commits its token; two
+    // sessions for the same ID can both get this far, but only one is marked first
+    if (!mark_token_generated(s->student)) {
+        BN_free(s_blinded);
+        session_fail(s, WIRE_STATUS_ALREADY_ISSUED, "Token for this student ID has already been generated");
+        return;
+    }
+
+    int queued = wire_conn_queue_bn(&s->conn, WIRE_MSG_BLIND_SIG, s_blinded);
+    BN_free(s_blinded);
+    s->state = queued ? SESSION_WAIT_COMMIT : SESSION_CLOSING;
+}
+
+static void session_on_commit(Session *s, const unsigned char *payload, uint32_t len) {
+    if (len != TOKEN_HASH_BYTES) {
+        session_fail(s, WIRE_STATUS_FAIL, "Invalid token hash");
+        return;
+    }
+
+    char token_hex[2 * TOKEN_HASH_BYTES + 1];
+    for (int i = 0; i < TOKEN_HASH_BYTES; i++) {
+        sprintf(token_hex + (i * 2), "%02x", payload[i]);
+    }
+
+    if (!write_token_immediately(token_hex)) {
+        fprintf(stderr, "CRITICAL ERROR: Token signed but failed to save to file for student ID %s!\n", s->student_id);
+        fprintf(stderr, "Token: %s\n", token_hex);
+        session_fail(s, WIRE_STATUS_FAIL, "Token signed but could not be registered");
+        return;
+    }
+
+    session_fail(s, WIRE_STATUS_OK, "Token registered.");
+    printf("Token for student ID %s has been successfully generated and saved.\n\n", s->student_id);
+}
+
+static void session_on_frame(Session *s, size_t slot, uint8_t type, const unsigned char *payload, uint32_t len) {
+    static const uint8_t expected[] = {
+        [SESSION_WAIT_ID] = WIRE_MSG_AUTH_ID,
+        [SESSION_WAIT_CODE] = WIRE_MSG_AUTH_CODE,
+        [SESSION_WAIT_BLIND] = WIRE_MSG_BLIND_REQ,
+        [SESSION_WAIT_COMMIT] = WIRE_MSG_TOKEN_COMMIT,
+    };
+    if (s->state == SESSION_SENDING_CODE || s->state == SESSION_CLOSING || type != expected[s->state]) {
+        session_fail(s, WIRE_STATUS_FAIL, "Unexpected message");
+        return;
+    }
+
+    switch (s->state) {
+    case SESSION_WAIT_ID: session_on_id(s, slot, payload, len); break;
+    case SESSION_WAIT_CODE: session_on_code(s, payload, len); break;
+    case SESSION_WAIT_BLIND: session_on_blind(s, payload, len); break;
+    case SESSION_WAIT_COMMIT: session_on_commit(s, payload, len); break;
+    default: break;
+    }
+}
+
+static void session_readable(SessionServer *srv, size_t slot) {
+    Session *s = srv->sessions[slot];
+    int open = wire_conn_fill(&s->conn);
+    timer_wheel_add(&srv->timers, &s->timer, (uint64_t)time(NULL) + CLIENT_TIMEOUT_SECONDS);
+
+    uint8_t type;
+    const unsigned char *payload;
+    uint32_t len;
+    int rc;
+    while (s->state != SESSION_CLOSING && (rc = wire_conn_frame(&s->conn, &type, &payload, &len)) != 0) {
+        if (rc < 0) {
+            close_session(srv, slot);
+            return;
+        }
+        session_on_frame(s, slot, type, payload, len);
+        wire_conn_consume(&s->conn);
+    }
+    if (!open) {
+        // the peer is gone; a queued reply can no longer be delivered
+        close_session(srv, slot);
+        return;
+    }
+    session_update(srv, slot);
+}
+
+static void mail_results_ready(SessionServer *srv) {
+    MailResult r;
+    while (read(mail_pipe[0], &r, sizeof(r)) == (ssize_t)sizeof(r)) {
+        if (r.slot >= srv->session_cap) continue;
+        Session *s = srv->sessions[r.slot];
+        if (!s || !s->active || s->generation != r.generation || s->state != SESSION_SENDING_CODE) continue;
+
+        if (r.status != 0) {
+            printf("Failed to send verification email. Please contact the administrator.\n\n");
+            session_fail(s, WIRE_STATUS_FAIL, "Verification failed");
+        } else {
+            printf("Verification code sent to %s.\n", s->student_id);
+            wire_conn_queue_status(&s->conn, WIRE_STATUS_OK, "Verification code sent. Please check your AUA email.");
+            s->state = SESSION_WAIT_CODE;
+        }
+        session_update(srv, r.slot);
+    }
+}
+
+static int grow_sessions(SessionServer *srv) {
+    size_t cap = srv->session_cap ? srv->session_cap * 2 : 64;
+    if (cap > UINT32_MAX >> 16) return 0;
+    Session **sessions = realloc(srv->sessions, cap * sizeof(*sessions));
+    if (!sessions) return 0;
+    srv->sessions = sessions;
+    size_t *free_slots = realloc(srv->free_slots, cap * sizeof(*free_slots));
+    if (!free_slots) return 0;
+    srv->free_slots = free_slots;
+
+    for (size_t i = srv->session_cap; i < cap; i++) srv->sessions[i] = NULL;
+    // hand out low slots first
+    for (size_t i = cap; i > srv->session_cap; i--) srv->free_slots[srv->free_count++] = i - 1;
+    srv->session_cap = cap;
+    return 1;
+}
+
+static void accept_sessions(SessionServer *srv) {
+    while (1) {
+        int fd = accept(srv->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EMFILE || errno == ENFILE) {
+                fprintf(stderr, "WARNING: out of file descriptors with %zu sessions open, pausing accept\n", srv->active);
+                epoll_ctl(srv->epoll_fd, EPOLL_CTL_DEL, srv->listen_fd, NULL);
+                srv->listen_paused = 1;
+            }
+            return;
+        }
+
+        if (!set_nonblocking(fd) || (srv->free_count == 0 && !grow_sessions(srv))) {
+            close(fd);
+            continue;
+        }
+        size_t slot = srv->free_slots[srv->free_count - 1];
+        if (!srv->sessions[slot] && !(srv->sessions[slot] = calloc(1, sizeof(Session)))) {
+            close(fd);
+            continue;
+        }
+        srv->free_count--;
+
+        Session *s = srv->sessions[slot];
+        wire_conn_init(&s->conn, fd);
+        s->active = 1;
+        s->events = EPOLLIN;
+        s->state = SESSION_WAIT_ID;
+        s->slot = slot;
+        s->student = -1;
+        // peers whose credentials cannot be read share one bucket
+        if (!wire_peer_uid(fd, &s->source)) s->source = UINT32_MAX;
+        timer_wheel_add(&srv->timers, &s->timer, (uint64_t)time(NULL) + CLIENT_TIMEOUT_SECONDS);
+        srv->active++;
+
+        struct epoll_event ev = { .events = EPOLLIN, .data.u64 = SERVER_TAG_SESSION + slot };
+        if (epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0 ||
+            !wire_conn_queue_pubkey(&s->conn, g_public_n, g_public_e)) {
+            close_session(srv, slot);
+            continue;
+        }
+        session_update(srv, slot);
+    }
+}
+
+static void session_timed_out(TimerNode *node, void *arg) {
+    Session *s = (Session *)((char *)node - offsetof(Session, timer));
+    close_session(arg, s->slot);
+}
+
+static int run_socket_server(const char *path, time_t start_time) {
+    SessionServer srv = { -1, -1, 0, NULL, 0, NULL, 0, 0 };
+    int rc = EXIT_FAILURE;
+    timer_wheel_init(&srv.timers, (uint64_t)time(NULL));
+
+    srv.listen_fd = wire_listen_unix(path);
+    if (srv.listen_fd < 0) {
+        fprintf(stderr, "Failed to listen on %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    srv.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev_listen = { .events = EPOLLIN, .data.u64 = SERVER_TAG_LISTEN };
+    struct epoll_event ev_mail = { .events = EPOLLIN, .data.u64 = SERVER_TAG_MAIL };
+    if (srv.epoll_fd < 0 || !set_nonblocking(srv.listen_fd) ||
+        pipe(mail_pipe) != 0 || !set_nonblocking(mail_pipe[0]) || !set_nonblocking(mail_pipe[1]) ||
+        epoll_ctl(srv.epoll_fd, EPOLL_CTL_ADD, srv.listen_fd, &ev_listen) != 0 ||
+        epoll_ctl(srv.epoll_fd, EPOLL_CTL_ADD, mail_pipe[0], &ev_mail) != 0) {
+        perror("session server setup");
+        goto done;
+    }
+
+    printf("Waiting for token clients on %s\n\n", path);
+
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    while (!registration_closed(start_time)) {
+        int n = epoll_wait(srv.epoll_fd, events, SERVER_MAX_EVENTS, 1000);
+        token_appender_poll(tokens_txt_out);
+        token_appender_poll(token_stage_out);
+
+        for (int i = 0; i < n; i++) {
+            uint64_t tag = events[i].data.u64;
+            if (tag == SERVER_TAG_LISTEN) {
+                accept_sessions(&srv);
+            } else if (tag == SERVER_TAG_MAIL) {
+                mail_results_ready(&srv);
+            } else {
+                size_t slot = (size_t)(tag - SERVER_TAG_SESSION);
+                Session *s = srv.sessions[slot];
+                if (!s->active) continue;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    session_readable(&srv, slot);
+                } else {
+                    session_update(&srv, slot);
+                }
+            }
+        }
+
+        timer_wheel_advance(&srv.timers, (uint64_t)time(NULL), session_timed_out, &srv);
+    }
+    rc = EXIT_SUCCESS;
+
+done:
+    for (size_t i = 0; i < srv.session_cap; i++) {
+        if (srv.sessions[i] && srv.sessions[i]->active) close_session(&srv, i);
+        free(srv.sessions[i]);
+    }
+    free(srv.sessions);
+    free(srv.free_slots);
+    // no mail callback may write to the pipe once it is closed
+    auth_mail_stop();
+    if (mail_pipe[0] >= 0) close(mail_pipe[0]);
+    if (mail_pipe[1] >= 0) close(mail_pipe[1]);
+    if (srv.epoll_fd >= 0) close(srv.epoll_fd);
+    close(srv.listen_fd);
+    unlink(path);
+    return rc;
+}
+
+int main(int argc, char *argv[]) {
+    int batch_mode = (argc == 4 && strcmp(argv[1], "--batch") == 0);
+    const char *listen_path = (argc == 3 && strcmp(argv[1], "--listen") == 0) ? argv[2] : NULL;
+    size_t batch_count = 0;
+    if ((argc != 1 && !batch_mode && !listen_path) || (batch_mode && !parse_batch_count(argv[2], &batch_count))) {
+        fprintf(stderr,
+                "Usage: %s [--batch <count> <out_file> | --listen <socket_path>]\n"
+                "  --batch: pre-issue <count> signed tokens (1 to %llu) into a binary record file.\n"
+                "  --listen: serve token_client sessions on a Unix socket instead of stdin.\n",
+                argv[0], MAX_BATCH_TOKENS);
+        return EXIT_FAILURE;
+    }
+
+    if (atexit(cleanup_token_registry) != 0 || atexit(merge_token_store) != 0 ||
+        atexit(close_token_outputs) != 0 || atexit(close_reg_snapshot) != 0) {
         fprintf(stderr, "Failed to register atexit handler\n");
         return EXIT_FAILURE;
     }
 
-    srand((unsigned int)time(NULL));
+    if (!batch_mode && !load_roster()) return EXIT_FAILURE;
+    if (!batch_mode && (!auth_mail_start() || atexit(auth_mail_stop) != 0)) {
+        fprintf(stderr, "Failed to start the mail dispatcher\n");
+        return EXIT_FAILURE;
+    }
+    size_t expected = batch_mode ? batch_count : (size_t)auth_get_student_count();
+
+    token_registry = token_registry_create(expected);
+    if (!token_registry) {
+        fprintf(stderr, "Failed to allocate token registry\n");
+        return EXIT_FAILURE;
+    }
+
+    // seeded once here; nonces, blinding factors and verification codes then draw
+    // from it without waiting, and a background thread keeps reseeding it
+    if (!entropy_start(1)) {
+        fprintf(stderr, "Failed to initialize RNG\n");
+        return EXIT_FAILURE;
+    }
 
-    if (!rsa_generate_keypair(&g_public_n, &g_public_e, &s_private_d, 2048)) {
+    if (!load_or_generate_keys()) {
         fprintf(stderr, "Key generation failed.\n");
         free_keys();
         return EXIT_FAILURE;
     }
 
+    // in --listen mode blinding happens on the client, so no local pool is needed
+    if (!listen_path && !token_generation_init(g_public_n, g_public_e)) {
+        free_keys();
+        return EXIT_FAILURE;
+    }
+
     printf("\n=== Public Key for Voting System ===\n");
     printf("N (hex): ");
     BN_print_fp(stdout, g_public_n);
@@ -210,21 +979,34 @@ int main(void) {
     BN_print_fp(stdout, g_public_e);
     printf("\n\n");
 
-    for (int i = 0; i < NUM_STUDENTS; i++) {
-        if (auth_add_student(STUDENT_IDS[i], STUDENT_MAILS[i]) != 0) {
-            fprintf(stderr, "Failed to add student %s\n", STUDENT_IDS[i]);
-            free_keys();
-            return EXIT_FAILURE;
-        }
+    // interactive sessions sync every token; the batch and socket paths let
+    // fdatasync trail writes by up to the sync window
+    TokenAppendPolicy policy = { 1, listen_path ? TOKEN_SYNC_WINDOW_MS : 0 };
+    if (batch_mode) policy = (TokenAppendPolicy){ TOKEN_BATCH_BUFFER_RECORDS, TOKEN_SYNC_WINDOW_MS };
+    if (!open_token_outputs(&policy)) {
+        free_keys();
+        return EXIT_FAILURE;
+    }
+    create_token_table(expected);
+
+    if (batch_mode) {
+        int rc = run_batch_issuance(batch_count, argv[3]);
+        free_keys();
+        return rc;
     }
 
     auth_sort_students();
+    if (!open_admission() || atexit(free_admission) != 0) {
+        free_keys();
+        return EXIT_FAILURE;
+    }
+    uint64_t window_used = open_reg_snapshot();
 
     printf("Registration system initialized.\n");
-    printf("RSA public key generated (n, e).\n");
-    printf("Private key kept locally (static).\n");
+    printf("RSA public key ready (n, e).\n");
+    printf("Private key kept locally in %s.\n", RSA_KEY_FILE);
     printf("Registration will stop when either:\n");
-    printf("  - all %d students have generated a token, or\n", NUM_STUDENTS);
+    printf("  - all %d students have generated a token, or\n", auth_get_student_count());
     printf("  - %d minutes have passed since start.\n\n", VOTING_DURATION_SECONDS / 60);
 
     time_t start_time = time(NULL);
@@ -233,27 +1015,18 @@ int main(void) {
         free_keys();
         return EXIT_FAILURE;
     }
+    // the window keeps counting from where the previous run stopped
+    start_time -= (time_t)window_used;
 
-    char input_buf[256];
-
-    while (1) {
-        time_t now = time(NULL);
-        if (now == (time_t)-1) {
-            fprintf(stderr, "time() failed.\n");
-            break;
-        }
-
-        double elapsed = difftime(now, start_time);
-        if (elapsed >= VOTING_DURATION_SECONDS) {
-            printf("\nTime limit (%d minutes) reached. Registration is now closed.\n", VOTING_DURATION_SECONDS/60);
-            break;
-        }
+    if (listen_path) {
+        int rc = run_socket_server(listen_path, start_time);
+        free_keys();
+        return rc;
+    }
 
-        if (auth_all_tokens_generated()) {
-            printf("\nAll students in the list have generated their tokens. Registration is now closed.\n");
-            break;
-        }
+    char input_buf[256];
 
+    while (!registration_closed(start_time)) {
         printf("Enter student ID: ");
         fflush(stdout);
 
@@ -272,21 +1045,41 @@ int main(void) {
             continue;
         }
 
-        int auth_result = auth_email_verify(input_buf);
+        if (!admit_code_request(input_buf, NULL)) {
+            printf("Too many verification requests for student ID %s. Please try again later.\n\n", input_buf);
+            continue;
+        }
+
+        int auth_result = auth_send_code(input_buf);
 
         if (auth_result == 2) {
             continue;
         }
 
+        // nonce, token hash and blinding do not depend on the code, so prepare them
+        // while the student is typing it and throw them away if verification fails
+        TokenPrefetch *prefetch = NULL;
+        if (auth_result == 0) {
+            prefetch = token_prefetch_start(g_public_n, g_public_e);
+            auth_result = auth_prompt_code(input_buf);
+        }
+
         if (auth_result == 1) {
+            token_prefetch_discard(prefetch);
             printf("Worng verification code\n\n");
             continue;
         }
 
         printf("Verification successful. Starting token generation for student ID %s...\n", input_buf);
 
+        TokenRequest *req = token_prefetch_join(prefetch);
+        if (!req) {
+            req = token_request_prepare(g_public_n, g_public_e);
+        }
+
         char *token_hex = NULL;
-        int rc = run_token_generation(g_public_n, g_public_e, &token_hex);
+        int rc = req ? token_request_finish(req, g_public_n, g_public_e, &token_hex) : 1;
+        token_request_free(req);
         if (rc != 0) {
             fprintf(stderr, "Token generation failed for student ID %s (rc = %d).\n\n", input_buf, rc);
             continue;
@@ -304,13 +1097,13 @@ int main(void) {
             continue;
         }
 
-        Student *s = auth_find_student(input_buf);
-        if (!s) {
+        int s = auth_find_student(input_buf);
+        if (s < 0) {
             fprintf(stderr, "Internal error: student not found after verification.\n\n");
             continue;
         }
 
-        s->token_generated = true;
+        mark_token_generated(s);
         printf("Token for student ID %s has been successfully generated and saved.\n\n", input_buf);
     }
 
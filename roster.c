@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include "roster.h"
+
+#define READ_CHUNK_BYTES (1u << 20)
+#define ROSTER_FIELDS 2
+
+typedef struct {
+    int (*fn)(const char *id, const char *email, void *arg);
+    void *arg;
+    RosterStats *stats;
+    char delim;  // 0 until the first row is seen
+    int header_checked;
+} Parser;
+
+// splits a line in place, unquoting and trimming fields; returns the number of fields
+static int split_fields(char *line, size_t len, char delim, char *fields[ROSTER_FIELDS]) {
+    int n = 0;
+    size_t i = 0;
+    while (n < ROSTER_FIELDS) {
+        while (i < len && line[i] == ' ') i++;
+        char *out = line + i;
+        fields[n++] = out;
+
+        if (i < len && line[i] == '"') {
+            for (i++; i < len; i++) {
+                if (line[i] == '"') {
+                    if (i + 1 < len && line[i + 1] == '"') {
+                        i++;
+                    } else {
+                        i++;
+                        break;
+                    }
+                }
+                *out++ = line[i];
+            }
+            while (i < len && line[i] != delim) i++;
+        } else {
+            char *start = out;
+            while (i < len && line[i] != delim) *out++ = line[i++];
+            while (out > start && out[-1] == ' ') out--;
+        }
+
+        int more = i < len;
+        *out = '\0';  // overwrites the delimiter or the line terminator
+        if (!more) break;
+        i++;
+    }
+    return n;
+}
+
+static int parse_line(Parser *p, char *line, size_t len) {
+    if (len > 0 && line[len - 1] == '\r') len--;
+    if (len == 0 || line[0] == '#') return 1;
+
+    if (!p->delim) p->delim = memchr(line, '\t', len) ? '\t' : ',';
+
+    char *fields[ROSTER_FIELDS];
+    int n = split_fields(line, len, p->delim, fields);
+
+    if (!p->header_checked) {
+        p->header_checked = 1;
+        if (strcasecmp(fields[0], "id") == 0 || strcasecmp(fields[0], "student_id") == 0) return 1;
+    }
+
+    if (n < ROSTER_FIELDS || fields[0][0] == '\0' || fields[1][0] == '\0') {
+        p->stats->skipped++;
+        return 1;
+    }
+
+    int rc = p->fn(fields[0], fields[1], p->arg);
+    if (rc < 0) return 0;
+    if (rc > 0) {
+        p->stats->rows++;
+    } else {
+        p->stats->skipped++;
+    }
+    return 1;
+}
+
+int roster_load(const char *path, int (*fn)(const char *id, const char *email, void *arg),
+                void *arg, RosterStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("open roster");
+        return 0;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // one spare byte so a final line without a newline can still be terminated in place
+    size_t cap = READ_CHUNK_BYTES;
+    char *buf = malloc(cap + 1);
+    if (!buf) {
+        close(fd);
+        return 0;
+    }
+
+    Parser p = { fn, arg, stats, 0, 0 };
+    size_t have = 0;
+    int ok = 1;
+    while (ok) {
+        // only a single line longer than the buffer makes it grow
+        if (have == cap) {
+            char *bigger = realloc(buf, cap * 2 + 1);
+            if (!bigger) {
+                fprintf(stderr, "Roster %s: out of memory for a %zu-byte line\n", path, have);
+                ok = 0;
+                break;
+            }
+            buf = bigger;
+            cap *= 2;
+        }
+
+        ssize_t n = read(fd, buf + have, cap - have);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("read roster");
+            ok = 0;
+            break;
+        }
+        int eof = (n == 0);
+        have += (size_t)n;
+        stats->bytes += (size_t)n;
+
+        size_t start = 0;
+        while (ok && start < have) {
+            char *nl = memchr(buf + start, '\n', have - start);
+            if (!nl) {
+                if (!eof) break;
+                nl = buf + have;
+            }
+            ok = parse_line(&p, buf + start, (size_t)(nl - (buf + start)));
+            start = (size_t)(nl - buf) + 1;
+        }
+        if (start > have) start = have;
+
+        memmove(buf, buf + start, have - start);
+        have -= start;
+        if (eof) break;
+    }
+
+    free(buf);
+    close(fd);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    stats->seconds = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+    return ok;
+}
@@ -0,0 +1,22 @@
+#ifndef ROSTER_H
+#define ROSTER_H
+
+#include <stddef.h>
+
+// "id,email" or "id<TAB>email" rows; the delimiter is taken from the first row.
+// double-quoted CSV fields, blank lines, '#' comments and an "id"/"student_id"
+// header row are accepted, and columns after the second are ignored
+typedef struct {
+    size_t rows;     // rows the callback accepted
+    size_t skipped;  // malformed or rejected rows
+    size_t bytes;
+    double seconds;
+} RosterStats;
+
+// fn receives NUL-terminated fields that are only valid during the call and returns
+// 1 to accept the row, 0 to reject it or -1 to stop. the file is read in fixed-size
+// chunks, so memory use does not depend on its size. returns 1 on success
+int roster_load(const char *path, int (*fn)(const char *id, const char *email, void *arg),
+                void *arg, RosterStats *stats);
+
+#endif
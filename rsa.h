@@ -5,6 +5,9 @@
 
 int rsa_generate_keypair(BIGNUM **n_out, BIGNUM **e_out, BIGNUM **d_out, int bits);
 
+int rsa_save_keypair(const char *path, const BIGNUM *n, const BIGNUM *e, const BIGNUM *d);
+int rsa_load_keypair(const char *path, BIGNUM **n_out, BIGNUM **e_out, BIGNUM **d_out);
+
 int rsa_encrypt(const BIGNUM *m, const BIGNUM *n, const BIGNUM *e, BIGNUM *c_out, BN_CTX *ctx);
 
 int rsa_decrypt(const BIGNUM *c, const BIGNUM *n, const BIGNUM *d, BIGNUM *m_out, BN_CTX *ctx);
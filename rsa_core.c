@@ -1,4 +1,9 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <openssl/bn.h>
+#include <openssl/crypto.h>
 #include "rsa.h"
 
 int rsa_generate_keypair(BIGNUM **n_out, BIGNUM **e_out, BIGNUM **d_out, int bits) {
@@ -86,3 +91,69 @@ int rsa_decrypt(const BIGNUM *c, const BIGNUM *n, const BIGNUM *d, BIGNUM *m_out
     return 1;
 }
 
+
+// three hex lines: n, e, d. written mode 0600 and renamed into place
+int rsa_save_keypair(const char *path, const BIGNUM *n, const BIGNUM *e, const BIGNUM *d) {
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    char *n_hex = BN_bn2hex(n);
+    char *e_hex = BN_bn2hex(e);
+    char *d_hex = BN_bn2hex(d);
+    int ret = 0;
+    FILE *f = NULL;
+    if (!n_hex || !e_hex || !d_hex) goto done;
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0 || !(f = fdopen(fd, "w"))) {
+        if (fd >= 0) close(fd);
+        perror("open rsa key");
+        goto done;
+    }
+
+    int ok = fprintf(f, "%s\n%s\n%s\n", n_hex, e_hex, d_hex) > 0;
+    if (fflush(f) != 0 || fsync(fileno(f)) != 0) ok = 0;
+    if (fclose(f) != 0) ok = 0;
+    if (!ok || rename(tmp_path, path) != 0) {
+        perror("write rsa key");
+        remove(tmp_path);
+        goto done;
+    }
+    ret = 1;
+
+done:
+    OPENSSL_free(n_hex);
+    OPENSSL_free(e_hex);
+    if (d_hex) OPENSSL_clear_free(d_hex, strlen(d_hex));
+    return ret;
+}
+
+// 1 if a complete key was read, 0 if the file is missing or malformed
+int rsa_load_keypair(const char *path, BIGNUM **n_out, BIGNUM **e_out, BIGNUM **d_out) {
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+
+    char line[3][2048];
+    int lines = 0;
+    while (lines < 3 && fgets(line[lines], sizeof(line[lines]), f)) {
+        line[lines][strcspn(line[lines], "\r\n")] = '\0';
+        lines++;
+    }
+    fclose(f);
+
+    BIGNUM *n = NULL, *e = NULL, *d = NULL;
+    if (lines != 3 || !BN_hex2bn(&n, line[0]) || !BN_hex2bn(&e, line[1]) || !BN_hex2bn(&d, line[2])) {
+        fprintf(stderr, "Malformed RSA key file %s\n", path);
+        BN_free(n);
+        BN_free(e);
+        BN_clear_free(d);
+        OPENSSL_cleanse(line, sizeof(line));
+        return 0;
+    }
+    OPENSSL_cleanse(line, sizeof(line));
+
+    *n_out = n;
+    *e_out = e;
+    *d_out = d;
+    return 1;
+}
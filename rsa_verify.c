@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <openssl/bn.h>
+#include "rsa_verify.h"
+
+#define RSA_F4_EXPONENT 65537
+#define RSA_F4_SQUARINGS 16
+
+struct RSAVerifyCtx {
+    BIGNUM *N;
+    BIGNUM *e;
+    int e_is_f4;
+    BN_MONT_CTX *mont;
+    BN_CTX *ctx;
+    BIGNUM *s_mont;
+    BIGNUM *acc;
+};
+
+RSAVerifyCtx *rsa_verify_ctx_new(const BIGNUM *N, const BIGNUM *e) {
+    if (!N || !e || !BN_is_odd(N)) return NULL;
+
+    RSAVerifyCtx *vctx = calloc(1, sizeof(*vctx));
+    if (!vctx) return NULL;
+
+    vctx->N = BN_dup(N);
+    vctx->e = BN_dup(e);
+    vctx->mont = BN_MONT_CTX_new();
+    vctx->ctx = BN_CTX_new();
+    vctx->s_mont = BN_new();
+    vctx->acc = BN_new();
+    if (!vctx->N || !vctx->e || !vctx->mont || !vctx->ctx || !vctx->s_mont || !vctx->acc) goto fail;
+
+    if (!BN_MONT_CTX_set(vctx->mont, vctx->N, vctx->ctx)) goto fail;
+
+    // 65537 = 2^16 + 1, so s^e is 16 squarings followed by one multiply by s
+    vctx->e_is_f4 = BN_is_word(vctx->e, RSA_F4_EXPONENT);
+
+    // warm up the temporaries and the BN_CTX pool to full width so later checks do not allocate
+    if (!BN_set_word(vctx->acc, 1)) goto fail;
+    if (!BN_to_montgomery(vctx->s_mont, vctx->acc, vctx->mont, vctx->ctx)) goto fail;
+    if (!BN_mod_mul_montgomery(vctx->acc, vctx->s_mont, vctx->s_mont, vctx->mont, vctx->ctx)) goto fail;
+    if (!BN_from_montgomery(vctx->acc, vctx->acc, vctx->mont, vctx->ctx)) goto fail;
+
+    return vctx;
+
+fail:
+    rsa_verify_ctx_free(vctx);
+    return NULL;
+}
+
+void rsa_verify_ctx_free(RSAVerifyCtx *vctx) {
+    if (!vctx) return;
+    BN_free(vctx->N);
+    BN_free(vctx->e);
+    BN_MONT_CTX_free(vctx->mont);
+    BN_CTX_free(vctx->ctx);
+    BN_free(vctx->s_mont);
+    BN_free(vctx->acc);
+    free(vctx);
+}
+
+int rsa_verify_ctx_check(RSAVerifyCtx *vctx, const BIGNUM *m, const BIGNUM *s) {
+    if (!vctx || !m || !s) return 0;
+    if (BN_is_negative(s) || BN_cmp(s, vctx->N) >= 0) return 0;
+
+    if (!vctx->e_is_f4) {
+        if (!BN_mod_exp_mont(vctx->acc, s, vctx->e, vctx->N, vctx->ctx, vctx->mont)) return 0;
+        return BN_cmp(vctx->acc, m) == 0;
+    }
+
+    if (!BN_to_montgomery(vctx->s_mont, s, vctx->mont, vctx->ctx)) return 0;
+    if (!BN_copy(vctx->acc, vctx->s_mont)) return 0;
+
+    for (int i = 0; i < RSA_F4_SQUARINGS; i++) {
+        if (!BN_mod_mul_montgomery(vctx->acc, vctx->acc, vctx->acc, vctx->mont, vctx->ctx)) return 0;
+    }
+    if (!BN_mod_mul_montgomery(vctx->acc, vctx->acc, vctx->s_mont, vctx->mont, vctx->ctx)) return 0;
+    if (!BN_from_montgomery(vctx->acc, vctx->acc, vctx->mont, vctx->ctx)) return 0;
+
+    return BN_cmp(vctx->acc, m) == 0;
+}
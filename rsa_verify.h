@@ -0,0 +1,16 @@
+#ifndef RSA_VERIFY_H
+#define RSA_VERIFY_H
+
+#include <openssl/bn.h>
+
+// per public key verification state, built once and reused for every signature.
+// not thread-safe: use one context per thread.
+typedef struct RSAVerifyCtx RSAVerifyCtx;
+
+RSAVerifyCtx *rsa_verify_ctx_new(const BIGNUM *N, const BIGNUM *e);
+void rsa_verify_ctx_free(RSAVerifyCtx *vctx);
+
+// returns 1 if s^e mod N == m, 0 otherwise
+int rsa_verify_ctx_check(RSAVerifyCtx *vctx, const BIGNUM *m, const BIGNUM *s);
+
+#endif
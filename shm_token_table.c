@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <openssl/sha.h>
+#include "shm_token_table.h"
+
+#define SHM_TABLE_MAGIC "EVSH"
+#define SHM_TABLE_VERSION 1
+#define SHM_TABLE_MIN_CAPACITY 1024
+#define BUSY_SPIN_LIMIT 1024  // yields before a BUSY slot is taken as left by a dead writer
+
+// slot states; a writer claims EMPTY -> BUSY, fills the key, then publishes LIVE
+enum {
+    SLOT_EMPTY = 0,
+    SLOT_BUSY,
+    SLOT_LIVE,
+    SLOT_SPENT,
+};
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t capacity;  // power of two
+    uint64_t count;     // updated atomically
+    uint32_t slot_size;
+    uint32_t ready;     // set last by the creator, after the slots are zeroed
+    unsigned char fingerprint[SHM_TOKEN_FINGERPRINT_BYTES];
+} ShmHeader;
+
+typedef struct {
+    uint32_t state;
+    uint32_t reserved;
+    unsigned char key[SHM_TOKEN_KEY_BYTES];
+} ShmSlot;
+
+struct ShmTokenTable {
+    ShmHeader *header;
+    ShmSlot *slots;
+    size_t map_len;
+};
+
+int shm_token_table_fingerprint(const BIGNUM *N, unsigned char out[SHM_TOKEN_FINGERPRINT_BYTES]) {
+    int len = BN_num_bytes(N);
+    unsigned char *buf = malloc(len > 0 ? (size_t)len : 1);
+    if (!buf) return 0;
+    BN_bn2bin(N, buf);
+    SHA256(buf, (size_t)len, out);
+    free(buf);
+    return 1;
+}
+
+static ShmTokenTable *map_table(int fd, size_t map_len, int prot) {
+    void *map = mmap(NULL, map_len, prot, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap shared token table");
+        return NULL;
+    }
+
+    ShmTokenTable *t = malloc(sizeof(*t));
+    if (!t) {
+        munmap(map, map_len);
+        return NULL;
+    }
+    t->header = map;
+    t->slots = (ShmSlot *)((unsigned char *)map + sizeof(ShmHeader));
+    t->map_len = map_len;
+    return t;
+}
+
+ShmTokenTable *shm_token_table_create(const char *name, size_t capacity,
+                                      const unsigned char fingerprint[SHM_TOKEN_FINGERPRINT_BYTES]) {
+    // doubling up to capacity * 2 must not wrap, nor may the mapping size
+    if (capacity > (SIZE_MAX - sizeof(ShmHeader)) / (4 * sizeof(ShmSlot))) {
+        fprintf(stderr, "Shared token table for %zu tokens is too large\n", capacity);
+        return NULL;
+    }
+    size_t cap = SHM_TABLE_MIN_CAPACITY;
+    while (cap < capacity * 2) cap *= 2;  // load factor stays under 1/2 at the requested size
+    size_t map_len = sizeof(ShmHeader) + cap * sizeof(ShmSlot);
+
+    // voting processes still attached to an old table keep their mapping
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        perror("shm_open shared token table");
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)map_len) != 0) {
+        perror("ftruncate shared token table");
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+
+    ShmTokenTable *t = map_table(fd, map_len, PROT_READ | PROT_WRITE);
+    close(fd);
+    if (!t) {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    // ftruncate zero-filled the slots
+    memcpy(t->header->magic, SHM_TABLE_MAGIC, 4);
+    t->header->version = SHM_TABLE_VERSION;
+    t->header->capacity = cap;
+    t->header->slot_size = sizeof(ShmSlot);
+    memcpy(t->header->fingerprint, fingerprint, SHM_TOKEN_FINGERPRINT_BYTES);
+    __atomic_store_n(&t->header->ready, 1, __ATOMIC_RELEASE);
+    return t;
+}
+
+ShmTokenTable *shm_token_table_attach(const char *name,
+                                      const unsigned char fingerprint[SHM_TOKEN_FINGERPRINT_BYTES]) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ShmHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    ShmTokenTable *t = map_table(fd, (size_t)st.st_size, PROT_READ | PROT_WRITE);
+    close(fd);
+    if (!t) return NULL;
+
+    ShmHeader *h = t->header;
+    int valid = __atomic_load_n(&h->ready, __ATOMIC_ACQUIRE) &&
+                memcmp(h->magic, SHM_TABLE_MAGIC, 4) == 0 &&
+                h->version == SHM_TABLE_VERSION &&
+                h->slot_size == sizeof(ShmSlot) &&
+                h->capacity != 0 && (h->capacity & (h->capacity - 1)) == 0 &&
+                sizeof(ShmHeader) + h->capacity * sizeof(ShmSlot) <= t->map_len;
+    if (!valid || memcmp(h->fingerprint, fingerprint, SHM_TOKEN_FINGERPRINT_BYTES) != 0) {
+        shm_token_table_detach(t);
+        return NULL;
+    }
+    return t;
+}
+
+void shm_token_table_detach(ShmTokenTable *t) {
+    if (!t) return;
+    munmap(t->header, t->map_len);
+    free(t);
+}
+
+// a BUSY slot is only ever held for the length of a 32-byte copy, unless its
+// writer died mid-insert. the wait is bounded so that never blocks anyone: a
+// slot still BUSY afterwards is skipped as holding no key, and the token it was
+// getting reads as absent from the table, so voting falls back to the files
+static uint32_t settled_state(const ShmSlot *slot) {
+    uint32_t state;
+    for (int spins = 0; (state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE)) == SLOT_BUSY &&
+                        spins < BUSY_SPIN_LIMIT; spins++) {
+        sched_yield();
+    }
+    return state;
+}
+
+static size_t key_hash(const unsigned char *key) {
+    // keys are SHA-256 outputs, so their leading bytes are already uniformly distributed
+    size_t h;
+    memcpy(&h, key, sizeof(h));
+    return h;
+}
+
+// returns the slot holding key, or NULL if a probe reached an empty slot first
+static ShmSlot *find_slot(const ShmTokenTable *t, const unsigned char *key) {
+    size_t mask = t->header->capacity - 1;
+    size_t i = key_hash(key) & mask;
+    for (size_t probes = 0; probes <= mask; probes++, i = (i + 1) & mask) {
+        ShmSlot *slot = &t->slots[i];
+        uint32_t state = settled_state(slot);
+        if (state == SLOT_EMPTY) return NULL;
+        if (state == SLOT_BUSY) continue;
+        if (memcmp(slot->key, key, SHM_TOKEN_KEY_BYTES) == 0) return slot;
+    }
+    return NULL;
+}
+
+int shm_token_table_insert(ShmTokenTable *t, const unsigned char key[SHM_TOKEN_KEY_BYTES]) {
+    size_t mask = t->header->capacity - 1;
+    size_t i = key_hash(key) & mask;
+    for (size_t probes = 0; probes <= mask; probes++, i = (i + 1) & mask) {
+        ShmSlot *slot = &t->slots[i];
+        uint32_t expected = SLOT_EMPTY;
+        if (__atomic_compare_exchange_n(&slot->state, &expected, SLOT_BUSY, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            memcpy(slot->key, key, SHM_TOKEN_KEY_BYTES);
+            __atomic_store_n(&slot->state, SLOT_LIVE, __ATOMIC_RELEASE);
+            __atomic_fetch_add(&t->header->count, 1, __ATOMIC_RELAXED);
+            return 1;
+        }
+        // another inserter owns this slot; wait for its key before comparing
+        if (settled_state(slot) == SLOT_BUSY) continue;
+        if (memcmp(slot->key, key, SHM_TOKEN_KEY_BYTES) == 0) return 0;
+    }
+    return -1;
+}
+
+int shm_token_table_lookup(const ShmTokenTable *t, const unsigned char key[SHM_TOKEN_KEY_BYTES]) {
+    ShmSlot *slot = find_slot(t, key);
+    if (!slot) return SHM_TOKEN_ABSENT;
+    return __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) == SLOT_SPENT ? SHM_TOKEN_SPENT : SHM_TOKEN_LIVE;
+}
+
+int shm_token_table_spend(ShmTokenTable *t, const unsigned char key[SHM_TOKEN_KEY_BYTES]) {
+    ShmSlot *slot = find_slot(t, key);
+    if (!slot) return -1;
+
+    uint32_t expected = SLOT_LIVE;
+    return __atomic_compare_exchange_n(&slot->state, &expected, SLOT_SPENT, 0,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ? 1 : 0;
+}
+
+size_t shm_token_table_count(const ShmTokenTable *t) {
+    return (size_t)__atomic_load_n(&t->header->count, __ATOMIC_RELAXED);
+}
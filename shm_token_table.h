@@ -0,0 +1,43 @@
+#ifndef SHM_TOKEN_TABLE_H
+#define SHM_TOKEN_TABLE_H
+
+#include <stddef.h>
+#include <openssl/bn.h>
+
+#define SHM_TOKEN_TABLE_NAME "/evote_tokens"
+#define SHM_TOKEN_KEY_BYTES 32
+#define SHM_TOKEN_FINGERPRINT_BYTES 32
+
+// POSIX shared-memory hash table of issued tokens. registration creates it and
+// inserts as it issues; voting processes attach and spend with a CAS on the
+// slot state, so neither side touches a file on the hot path. the header binds
+// the table to one RSA public key so voting never trusts another election's table
+typedef struct ShmTokenTable ShmTokenTable;
+
+// SHA-256 of the public modulus, identifying the election in the table header
+int shm_token_table_fingerprint(const BIGNUM *N, unsigned char out[SHM_TOKEN_FINGERPRINT_BYTES]);
+
+// replaces any table left under name by an earlier run; capacity is a lower bound
+ShmTokenTable *shm_token_table_create(const char *name, size_t capacity,
+                                      const unsigned char fingerprint[SHM_TOKEN_FINGERPRINT_BYTES]);
+// NULL if there is no table, or it belongs to another key or layout version
+ShmTokenTable *shm_token_table_attach(const char *name,
+                                      const unsigned char fingerprint[SHM_TOKEN_FINGERPRINT_BYTES]);
+// unmaps only; the table outlives the process until the next create
+void shm_token_table_detach(ShmTokenTable *t);
+
+// 1 if inserted, 0 if already present, -1 if the table is full
+int shm_token_table_insert(ShmTokenTable *t, const unsigned char key[SHM_TOKEN_KEY_BYTES]);
+
+enum {
+    SHM_TOKEN_ABSENT = 0,
+    SHM_TOKEN_LIVE,
+    SHM_TOKEN_SPENT,
+};
+int shm_token_table_lookup(const ShmTokenTable *t, const unsigned char key[SHM_TOKEN_KEY_BYTES]);
+// 1 if this call spent the token, 0 if it was already spent, -1 if it is absent
+int shm_token_table_spend(ShmTokenTable *t, const unsigned char key[SHM_TOKEN_KEY_BYTES]);
+
+size_t shm_token_table_count(const ShmTokenTable *t);
+
+#endif
@@ -0,0 +1,610 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <openssl/rand.h>
+#include "crc32.h"
+#include "spent_filter.h"
+
+#define SPENT_FILTER_HASHES 7
+#define SPENT_FILTER_BITS_PER_ITEM 10  // ~1% false positives with 7 hashes
+#define SPENT_FILTER_MIN_BITS (1u << 16)
+#define DELTA_MAGIC "EVSD"
+#define DELTA_SUFFIX ".delta"
+#define SNAPSHOT_MAGIC "EVSM"
+#define SNAPSHOT_NAME "merged.snapshot"
+#define SNAPSHOT_HEADER_BYTES 24
+#define COMPACT_LOCK_NAME ".compact.lock"
+#define COMPACT_MIN_DELTAS 64  // deltas in the directory before they are folded into the snapshot
+
+typedef struct {
+    unsigned long long id;
+    unsigned long long next_seq;
+} Writer;
+
+struct SpentFilter {
+    unsigned long long *bits;
+    size_t mask;  // number of bits - 1
+
+    char *dir;
+    unsigned int interval_ms;
+    unsigned long long self_id;
+    unsigned long long self_seq;
+
+    Writer *writers;  // other processes whose deltas we have merged, sync thread only
+    size_t writer_count, writer_cap;
+    unsigned long long snapshot_gen;  // generation of the merged snapshot already applied
+
+    pthread_mutex_t lock;  // guards everything below
+    pthread_cond_t wake;
+    unsigned char *pending;  // local spends not yet published
+    size_t pending_count, pending_cap;
+    int stop;
+    pthread_t thread;
+};
+
+// keys are SHA-256 outputs, so two 64-bit slices give independent hashes for double hashing
+static void key_hashes(const unsigned char *key, unsigned long long *h1, unsigned long long *h2) {
+    memcpy(h1, key, sizeof(*h1));
+    memcpy(h2, key + sizeof(*h1), sizeof(*h2));
+    *h2 |= 1;
+}
+
+static void set_bits(SpentFilter *f, const unsigned char *key) {
+    unsigned long long h1, h2;
+    key_hashes(key, &h1, &h2);
+    for (int i = 0; i < SPENT_FILTER_HASHES; i++) {
+        size_t bit = (size_t)(h1 + (unsigned long long)i * h2) & f->mask;
+        __atomic_fetch_or(&f->bits[bit / 64], 1ULL << (bit % 64), __ATOMIC_RELAXED);
+    }
+}
+
+int spent_filter_maybe_contains(const SpentFilter *f, const unsigned char key[SPENT_FILTER_KEY_BYTES]) {
+    unsigned long long h1, h2;
+    key_hashes(key, &h1, &h2);
+    for (int i = 0; i < SPENT_FILTER_HASHES; i++) {
+        size_t bit = (size_t)(h1 + (unsigned long long)i * h2) & f->mask;
+        if (!(__atomic_load_n(&f->bits[bit / 64], __ATOMIC_RELAXED) & (1ULL << (bit % 64)))) return 0;
+    }
+    return 1;
+}
+
+static void delta_path(char *out, size_t out_len, const char *dir, unsigned long long id, unsigned long long seq) {
+    snprintf(out, out_len, "%s/%016llx-%08llu" DELTA_SUFFIX, dir, id, seq);
+}
+
+// delta file: magic | u32 count | count keys | crc32 of everything before it.
+// written to a dot-file and renamed so readers never see a partial snapshot.
+// no fsync: a lost delta only costs a filter miss, the spent log stays authoritative
+static int publish_pending(SpentFilter *f) {
+    pthread_mutex_lock(&f->lock);
+    size_t count = f->pending_count;
+    unsigned char *keys = f->pending;
+    f->pending = NULL;
+    f->pending_count = f->pending_cap = 0;
+    pthread_mutex_unlock(&f->lock);
+
+    if (count == 0) return 1;
+
+    char path[4096], tmp_path[4096];
+    delta_path(path, sizeof(path), f->dir, f->self_id, f->self_seq);
+    snprintf(tmp_path, sizeof(tmp_path), "%s/.%016llx.tmp", f->dir, f->self_id);
+
+    int ok = 0;
+    FILE *out = fopen(tmp_path, "wb");
+    if (!out) {
+        perror("open spent delta");
+        goto done;
+    }
+
+    unsigned char head[8];
+    memcpy(head, DELTA_MAGIC, 4);
+    head[4] = (unsigned char)(count >> 24);
+    head[5] = (unsigned char)(count >> 16);
+    head[6] = (unsigned char)(count >> 8);
+    head[7] = (unsigned char)count;
+    uint32_t crc = crc32_update(0, head, sizeof(head));
+    crc = crc32_update(crc, keys, count * SPENT_FILTER_KEY_BYTES);
+    unsigned char tail[4] = { crc >> 24, crc >> 16, crc >> 8, crc };
+
+    int written = fwrite(head, 1, sizeof(head), out) == sizeof(head) &&
+                  fwrite(keys, SPENT_FILTER_KEY_BYTES, count, out) == count &&
+                  fwrite(tail, 1, sizeof(tail), out) == sizeof(tail);
+    if (fclose(out) != 0 || !written || rename(tmp_path, path) != 0) {
+        perror("write spent delta");
+        remove(tmp_path);
+        goto done;
+    }
+
+    f->self_seq++;
+    ok = 1;
+
+done:
+    free(keys);
+    return ok;
+}
+
+static void put_be32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (24 - 8 * i));
+}
+
+static uint32_t get_be32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void put_be64(unsigned char *p, unsigned long long v) {
+    put_be32(p, (uint32_t)(v >> 32));
+    put_be32(p + 4, (uint32_t)v);
+}
+
+static unsigned long long get_be64(const unsigned char *p) {
+    return ((unsigned long long)get_be32(p) << 32) | get_be32(p + 4);
+}
+
+// reads a whole delta or snapshot file and checks its trailing crc; 1 if read,
+// 0 if it does not exist, -1 if it is unreadable
+static int read_checked(const char *path, const char *magic, unsigned char **data_out, size_t *len_out) {
+    FILE *in = fopen(path, "rb");
+    if (!in) return errno == ENOENT ? 0 : -1;
+
+    int rc = -1;
+    unsigned char *data = NULL;
+    struct stat st;
+    if (fstat(fileno(in), &st) != 0 || st.st_size < 8) goto done;
+
+    size_t len = (size_t)st.st_size;
+    data = malloc(len);
+    if (!data || fread(data, 1, len, in) != len || memcmp(data, magic, 4) != 0) goto done;
+    if (crc32_update(0, data, len - 4) != get_be32(data + len - 4)) goto done;
+
+    *data_out = data;
+    *len_out = len - 4;
+    data = NULL;
+    rc = 1;
+
+done:
+    free(data);
+    fclose(in);
+    return rc;
+}
+
+// keys of one delta, pointing into the buffer returned in *data_out
+static int read_delta(const char *path, unsigned char **data_out, const unsigned char **keys, uint32_t *count) {
+    size_t len;
+    int rc = read_checked(path, DELTA_MAGIC, data_out, &len);
+    if (rc <= 0) return rc;
+
+    *count = get_be32(*data_out + 4);
+    if (len < 8 || (len - 8) / SPENT_FILTER_KEY_BYTES != *count || (len - 8) % SPENT_FILTER_KEY_BYTES != 0) {
+        free(*data_out);
+        return -1;
+    }
+    *keys = *data_out + 8;
+    return 1;
+}
+
+// 1 if merged, 0 if the snapshot does not exist yet, -1 if it is unreadable
+static int merge_delta(SpentFilter *f, const char *path) {
+    unsigned char *data;
+    const unsigned char *keys;
+    uint32_t count;
+    int rc = read_delta(path, &data, &keys, &count);
+    if (rc <= 0) return rc;
+
+    for (uint32_t i = 0; i < count; i++) set_bits(f, keys + (size_t)i * SPENT_FILTER_KEY_BYTES);
+    free(data);
+    return 1;
+}
+
+// the merged snapshot holds every key from the deltas it replaced, and for each
+// writer the first sequence number it does not cover:
+// magic | u32 writer count | u64 generation | u64 key count | (u64 id, u64 next seq)... | keys | crc32
+typedef struct {
+    unsigned long long gen;
+    Writer *writers;
+    size_t writer_count, writer_cap;
+    unsigned char *keys;
+    size_t key_count, key_cap;
+} Snapshot;
+
+static void snapshot_path(char *out, size_t out_len, const char *dir) {
+    snprintf(out, out_len, "%s/" SNAPSHOT_NAME, dir);
+}
+
+static void snapshot_free(Snapshot *snap) {
+    free(snap->writers);
+    free(snap->keys);
+    memset(snap, 0, sizeof(*snap));
+}
+
+// 1 if loaded, 0 if there is none, -1 if it is unreadable
+static int snapshot_read(const char *dir, Snapshot *snap) {
+    char path[4096];
+    snapshot_path(path, sizeof(path), dir);
+    memset(snap, 0, sizeof(*snap));
+
+    unsigned char *data;
+    size_t len;
+    int rc = read_checked(path, SNAPSHOT_MAGIC, &data, &len);
+    if (rc <= 0) return rc;
+
+    if (len < SNAPSHOT_HEADER_BYTES) goto corrupt;
+    size_t writers = get_be32(data + 4);
+    unsigned long long keys = get_be64(data + 16);
+    if ((len - SNAPSHOT_HEADER_BYTES) / 16 < writers ||
+        (len - SNAPSHOT_HEADER_BYTES - writers * 16) / SPENT_FILTER_KEY_BYTES != keys ||
+        (len - SNAPSHOT_HEADER_BYTES - writers * 16) % SPENT_FILTER_KEY_BYTES != 0) goto corrupt;
+
+    snap->gen = get_be64(data + 8);
+    snap->writers = malloc((writers ? writers : 1) * sizeof(Writer));
+    snap->keys = malloc(keys ? keys * SPENT_FILTER_KEY_BYTES : 1);
+    if (!snap->writers || !snap->keys) goto corrupt;
+    for (size_t i = 0; i < writers; i++) {
+        snap->writers[i].id = get_be64(data + SNAPSHOT_HEADER_BYTES + i * 16);
+        snap->writers[i].next_seq = get_be64(data + SNAPSHOT_HEADER_BYTES + i * 16 + 8);
+    }
+    memcpy(snap->keys, data + SNAPSHOT_HEADER_BYTES + writers * 16, keys * SPENT_FILTER_KEY_BYTES);
+    snap->writer_count = snap->writer_cap = writers;
+    snap->key_count = snap->key_cap = keys;
+    free(data);
+    return 1;
+
+corrupt:
+    free(data);
+    snapshot_free(snap);
+    return -1;
+}
+
+// generation of the snapshot on disk without reading its keys; 0 if there is none
+static unsigned long long snapshot_peek_gen(const char *dir) {
+    char path[4096];
+    snapshot_path(path, sizeof(path), dir);
+    FILE *in = fopen(path, "rb");
+    if (!in) return 0;
+    unsigned char head[SNAPSHOT_HEADER_BYTES];
+    unsigned long long gen = 0;
+    if (fread(head, 1, sizeof(head), in) == sizeof(head) && memcmp(head, SNAPSHOT_MAGIC, 4) == 0) {
+        gen = get_be64(head + 8);
+    }
+    fclose(in);
+    return gen;
+}
+
+static Writer *find_writer(SpentFilter *f, unsigned long long id) {
+    for (size_t i = 0; i < f->writer_count; i++) {
+        if (f->writers[i].id == id) return &f->writers[i];
+    }
+
+    if (f->writer_count == f->writer_cap) {
+        size_t cap = f->writer_cap ? f->writer_cap * 2 : 8;
+        Writer *w = realloc(f->writers, cap * sizeof(Writer));
+        if (!w) return NULL;
+        f->writers = w;
+        f->writer_cap = cap;
+    }
+    Writer *w = &f->writers[f->writer_count++];
+    w->id = id;
+    w->next_seq = 0;
+    return w;
+}
+
+// the directory listing only discovers writers; each writer's snapshots are
+// then merged strictly in sequence so none is skipped
+// a new snapshot comes first: the deltas it folded in may already be gone
+static void apply_snapshot(SpentFilter *f) {
+    unsigned long long gen = snapshot_peek_gen(f->dir);
+    if (gen == 0 || gen == f->snapshot_gen) return;
+
+    Snapshot snap;
+    if (snapshot_read(f->dir, &snap) <= 0) return;
+    for (size_t i = 0; i < snap.key_count; i++) set_bits(f, snap.keys + i * SPENT_FILTER_KEY_BYTES);
+    for (size_t i = 0; i < snap.writer_count; i++) {
+        if (snap.writers[i].id == f->self_id) continue;
+        Writer *w = find_writer(f, snap.writers[i].id);
+        if (w && w->next_seq < snap.writers[i].next_seq) w->next_seq = snap.writers[i].next_seq;
+    }
+    f->snapshot_gen = snap.gen;
+    snapshot_free(&snap);
+}
+
+// returns how many delta files the directory held, this process's included
+static size_t merge_others(SpentFilter *f) {
+    apply_snapshot(f);
+
+    DIR *d = opendir(f->dir);
+    if (!d) return 0;
+
+    size_t deltas = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        unsigned long long id, seq;
+        if (ent->d_name[0] == '.' || sscanf(ent->d_name, "%16llx-%llu", &id, &seq) != 2) continue;
+        deltas++;
+        if (id == f->self_id) continue;
+
+        Writer *w = find_writer(f, id);
+        if (!w || seq < w->next_seq) continue;
+
+        char path[4096];
+        while (1) {
+            delta_path(path, sizeof(path), f->dir, id, w->next_seq);
+            int rc = merge_delta(f, path);
+            if (rc == 0) break;
+            if (rc < 0) fprintf(stderr, "Skipping unreadable spent delta %s\n", path);
+            w->next_seq++;
+        }
+    }
+    closedir(d);
+    return deltas;
+}
+
+static Writer *snapshot_writer(Snapshot *snap, unsigned long long id, unsigned long long first_seq) {
+    for (size_t i = 0; i < snap->writer_count; i++) {
+        if (snap->writers[i].id == id) return &snap->writers[i];
+    }
+    if (snap->writer_count == snap->writer_cap) {
+        size_t cap = snap->writer_cap ? snap->writer_cap * 2 : 8;
+        Writer *w = realloc(snap->writers, cap * sizeof(Writer));
+        if (!w) return NULL;
+        snap->writers = w;
+        snap->writer_cap = cap;
+    }
+    Writer *w = &snap->writers[snap->writer_count++];
+    w->id = id;
+    w->next_seq = first_seq;
+    return w;
+}
+
+static int snapshot_add_keys(Snapshot *snap, const unsigned char *keys, size_t count) {
+    if (snap->key_count + count > snap->key_cap) {
+        size_t cap = snap->key_cap ? snap->key_cap : 1024;
+        while (cap < snap->key_count + count) cap *= 2;
+        unsigned char *k = realloc(snap->keys, cap * SPENT_FILTER_KEY_BYTES);
+        if (!k) return 0;
+        snap->keys = k;
+        snap->key_cap = cap;
+    }
+    memcpy(snap->keys + snap->key_count * SPENT_FILTER_KEY_BYTES, keys, count * SPENT_FILTER_KEY_BYTES);
+    snap->key_count += count;
+    return 1;
+}
+
+// synced before the deltas it replaces are removed, so a crash loses neither
+static int snapshot_write(const char *dir, const Snapshot *snap) {
+    char path[4096], tmp_path[4096];
+    snapshot_path(path, sizeof(path), dir);
+    snprintf(tmp_path, sizeof(tmp_path), "%s/." SNAPSHOT_NAME ".tmp", dir);
+
+    unsigned char head[SNAPSHOT_HEADER_BYTES], pair[16], tail[4];
+    memcpy(head, SNAPSHOT_MAGIC, 4);
+    put_be32(head + 4, (uint32_t)snap->writer_count);
+    put_be64(head + 8, snap->gen);
+    put_be64(head + 16, snap->key_count);
+
+    FILE *out = fopen(tmp_path, "wb");
+    if (!out) {
+        perror("open spent snapshot");
+        return 0;
+    }
+    uint32_t crc = crc32_update(0, head, sizeof(head));
+    int written = fwrite(head, 1, sizeof(head), out) == sizeof(head);
+    for (size_t i = 0; written && i < snap->writer_count; i++) {
+        put_be64(pair, snap->writers[i].id);
+        put_be64(pair + 8, snap->writers[i].next_seq);
+        crc = crc32_update(crc, pair, sizeof(pair));
+        written = fwrite(pair, 1, sizeof(pair), out) == sizeof(pair);
+    }
+    crc = crc32_update(crc, snap->keys, snap->key_count * SPENT_FILTER_KEY_BYTES);
+    put_be32(tail, crc);
+    written = written && fwrite(snap->keys, SPENT_FILTER_KEY_BYTES, snap->key_count, out) == snap->key_count &&
+              fwrite(tail, 1, sizeof(tail), out) == sizeof(tail) &&
+              fflush(out) == 0 && fsync(fileno(out)) == 0;
+    if (fclose(out) != 0 || !written || rename(tmp_path, path) != 0) {
+        perror("write spent snapshot");
+        remove(tmp_path);
+        return 0;
+    }
+    return 1;
+}
+
+// folds every writer's run of consecutive deltas into a new snapshot and
+// removes them, so the directory stays small however many merges happen.
+// one process compacts at a time; the others skip the round
+static void compact_deltas(SpentFilter *f) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/" COMPACT_LOCK_NAME, f->dir);
+    int lock_fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (lock_fd < 0) return;
+    if (flock(lock_fd, LOCK_EX | LOCK_NB) != 0) {
+        close(lock_fd);
+        return;
+    }
+
+    Snapshot snap;
+    if (snapshot_read(f->dir, &snap) < 0) {
+        // its keys are lost to the filter, the spent log still has them
+        fprintf(stderr, "Replacing unreadable spent snapshot in %s\n", f->dir);
+    }
+    size_t known = snap.writer_count;
+
+    unsigned long long *folded = NULL;  // (id, seq) of every delta taken in
+    size_t folded_count = 0, folded_cap = 0;
+    int ok = 1;
+
+    // writers the snapshot does not know yet start at their oldest delta
+    DIR *d = opendir(f->dir);
+    if (!d) goto done;
+    struct dirent *ent;
+    while (ok && (ent = readdir(d)) != NULL) {
+        unsigned long long id, seq;
+        if (ent->d_name[0] == '.' || sscanf(ent->d_name, "%16llx-%llu", &id, &seq) != 2) continue;
+        Writer *w = snapshot_writer(&snap, id, seq);
+        if (!w) {
+            ok = 0;
+        } else if ((size_t)(w - snap.writers) >= known) {
+            if (seq < w->next_seq) w->next_seq = seq;
+        } else if (seq < w->next_seq) {
+            // already in the snapshot, left behind by a compaction that did not finish
+            delta_path(path, sizeof(path), f->dir, id, seq);
+            remove(path);
+        }
+    }
+    closedir(d);
+
+    for (size_t i = 0; ok && i < snap.writer_count; i++) {
+        Writer *w = &snap.writers[i];
+        while (ok) {
+            delta_path(path, sizeof(path), f->dir, w->id, w->next_seq);
+            unsigned char *data;
+            const unsigned char *keys;
+            uint32_t count;
+            int rc = read_delta(path, &data, &keys, &count);
+            if (rc == 0) break;
+            if (rc > 0) {
+                ok = snapshot_add_keys(&snap, keys, count);
+                free(data);
+            }
+            if (folded_count == folded_cap) {
+                size_t cap = folded_cap ? folded_cap * 2 : 64;
+                unsigned long long *p = realloc(folded, cap * 2 * sizeof(*folded));
+                if (!p) {
+                    ok = 0;
+                    break;
+                }
+                folded = p;
+                folded_cap = cap;
+            }
+            folded[2 * folded_count] = w->id;
+            folded[2 * folded_count + 1] = w->next_seq;
+            folded_count++;
+            w->next_seq++;
+        }
+    }
+    if (!ok || folded_count < COMPACT_MIN_DELTAS) goto done;
+
+    snap.gen++;
+    if (!snapshot_write(f->dir, &snap)) goto done;
+    for (size_t i = 0; i < folded_count; i++) {
+        delta_path(path, sizeof(path), f->dir, folded[2 * i], folded[2 * i + 1]);
+        remove(path);
+    }
+
+done:
+    free(folded);
+    snapshot_free(&snap);
+    flock(lock_fd, LOCK_UN);
+    close(lock_fd);
+}
+
+static void *sync_main(void *arg) {
+    SpentFilter *f = arg;
+
+    pthread_mutex_lock(&f->lock);
+    while (!f->stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += f->interval_ms / 1000;
+        deadline.tv_nsec += (long)(f->interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&f->wake, &f->lock, &deadline);
+        pthread_mutex_unlock(&f->lock);
+
+        publish_pending(f);
+        if (merge_others(f) >= COMPACT_MIN_DELTAS) compact_deltas(f);
+
+        pthread_mutex_lock(&f->lock);
+    }
+    pthread_mutex_unlock(&f->lock);
+    return NULL;
+}
+
+SpentFilter *spent_filter_create(size_t expected_items, const char *dir, unsigned int interval_ms) {
+    SpentFilter *f = calloc(1, sizeof(*f));
+    if (!f) return NULL;
+
+    size_t nbits = SPENT_FILTER_MIN_BITS;
+    while (nbits < expected_items * SPENT_FILTER_BITS_PER_ITEM) nbits *= 2;
+    f->mask = nbits - 1;
+    f->bits = calloc(nbits / 64, sizeof(*f->bits));
+    f->dir = strdup(dir);
+    f->interval_ms = interval_ms;
+    if (!f->bits || !f->dir) goto fail;
+
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+        perror("mkdir spent filter dir");
+        goto fail;
+    }
+    if (RAND_bytes((unsigned char *)&f->self_id, sizeof(f->self_id)) != 1) {
+        fprintf(stderr, "RAND_bytes failed\n");
+        goto fail;
+    }
+
+    // pick up everything other processes already spent before the first vote
+    merge_others(f);
+
+    pthread_mutex_init(&f->lock, NULL);
+    pthread_cond_init(&f->wake, NULL);
+    if (pthread_create(&f->thread, NULL, sync_main, f) != 0) {
+        pthread_cond_destroy(&f->wake);
+        pthread_mutex_destroy(&f->lock);
+        goto fail;
+    }
+    return f;
+
+fail:
+    free(f->writers);
+    free(f->bits);
+    free(f->dir);
+    free(f);
+    return NULL;
+}
+
+void spent_filter_free(SpentFilter *f) {
+    if (!f) return;
+
+    pthread_mutex_lock(&f->lock);
+    f->stop = 1;
+    pthread_cond_signal(&f->wake);
+    pthread_mutex_unlock(&f->lock);
+    pthread_join(f->thread, NULL);
+
+    publish_pending(f);
+
+    pthread_cond_destroy(&f->wake);
+    pthread_mutex_destroy(&f->lock);
+    free(f->pending);
+    free(f->writers);
+    free(f->bits);
+    free(f->dir);
+    free(f);
+}
+
+void spent_filter_add(SpentFilter *f, const unsigned char key[SPENT_FILTER_KEY_BYTES]) {
+    set_bits(f, key);
+
+    pthread_mutex_lock(&f->lock);
+    if (f->pending_count == f->pending_cap) {
+        size_t cap = f->pending_cap ? f->pending_cap * 2 : 64;
+        unsigned char *p = realloc(f->pending, cap * SPENT_FILTER_KEY_BYTES);
+        if (!p) {
+            // other processes will still see it through the spent log
+            pthread_mutex_unlock(&f->lock);
+            return;
+        }
+        f->pending = p;
+        f->pending_cap = cap;
+    }
+    memcpy(f->pending + f->pending_count * SPENT_FILTER_KEY_BYTES, key, SPENT_FILTER_KEY_BYTES);
+    f->pending_count++;
+    pthread_mutex_unlock(&f->lock);
+}
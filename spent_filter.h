@@ -0,0 +1,27 @@
+#ifndef SPENT_FILTER_H
+#define SPENT_FILTER_H
+
+#include <stddef.h>
+
+#define SPENT_FILTER_KEY_BYTES 32
+
+// Bloom filter of spent token hashes shared between voting processes. each
+// process publishes the hashes it spent as delta snapshots in a common
+// directory and merges everyone else's, so a token spent elsewhere is noticed
+// without touching disk. once enough deltas pile up one process folds them into
+// a merged snapshot and removes them. a hit only means "maybe spent" and must be
+// confirmed against the authoritative spent log
+typedef struct SpentFilter SpentFilter;
+
+// sizes the filter for expected_items and starts a thread that publishes and
+// merges deltas in dir every interval_ms
+SpentFilter *spent_filter_create(size_t expected_items, const char *dir, unsigned int interval_ms);
+// publishes any remaining local spends, then stops the thread
+void spent_filter_free(SpentFilter *f);
+
+// records a local spend; safe to call concurrently with lookups and the sync thread
+void spent_filter_add(SpentFilter *f, const unsigned char key[SPENT_FILTER_KEY_BYTES]);
+// 0 if the token was definitely not spent by any process seen so far
+int spent_filter_maybe_contains(const SpentFilter *f, const unsigned char key[SPENT_FILTER_KEY_BYTES]);
+
+#endif
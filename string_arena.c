@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "string_arena.h"
+
+#define BLOCK_BYTES (1u << 20)
+#define MIN_CAPACITY 1024
+
+typedef struct Block {
+    struct Block *next;
+    size_t used, size;
+    char data[];
+} Block;
+
+typedef struct {
+    const char *str;  // NULL when empty
+    uint32_t len;
+    uint32_t tag;     // high hash bits, compared before the string
+} Slot;
+
+struct StringArena {
+    Block *blocks;  // newest first
+    size_t bytes;
+
+    Slot *slots;
+    size_t capacity;  // power of two
+    size_t count;
+};
+
+static uint64_t fnv1a(const char *s, size_t len) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+StringArena *string_arena_create(size_t expected_strings) {
+    StringArena *a = calloc(1, sizeof(*a));
+    if (!a) return NULL;
+
+    // doubling up to expected_strings * 2 must not wrap the capacity to 0
+    if (expected_strings > SIZE_MAX / 4) {
+        free(a);
+        return NULL;
+    }
+    a->capacity = MIN_CAPACITY;
+    while (a->capacity < expected_strings * 2) a->capacity *= 2;
+    a->slots = calloc(a->capacity, sizeof(Slot));
+    if (!a->slots) {
+        free(a);
+        return NULL;
+    }
+    return a;
+}
+
+void string_arena_free(StringArena *a) {
+    if (!a) return;
+    Block *b = a->blocks;
+    while (b) {
+        Block *next = b->next;
+        free(b);
+        b = next;
+    }
+    free(a->slots);
+    free(a);
+}
+
+const char *string_arena_copy(StringArena *a, const char *s, size_t len) {
+    Block *b = a->blocks;
+    if (!b || b->size - b->used < len + 1) {
+        size_t size = len + 1 > BLOCK_BYTES ? len + 1 : BLOCK_BYTES;
+        b = malloc(sizeof(Block) + size);
+        if (!b) return NULL;
+        b->used = 0;
+        b->size = size;
+        b->next = a->blocks;
+        a->blocks = b;
+    }
+
+    char *out = b->data + b->used;
+    memcpy(out, s, len);
+    out[len] = '\0';
+    b->used += len + 1;
+    a->bytes += len + 1;
+    return out;
+}
+
+static Slot *find_slot(Slot *slots, size_t capacity, const char *s, size_t len, uint64_t h) {
+    size_t mask = capacity - 1;
+    uint32_t tag = (uint32_t)(h >> 32);
+    for (size_t i = (size_t)h & mask;; i = (i + 1) & mask) {
+        Slot *slot = &slots[i];
+        if (!slot->str) return slot;
+        if (slot->tag == tag && slot->len == len && memcmp(slot->str, s, len) == 0) return slot;
+    }
+}
+
+static int grow(StringArena *a) {
+    size_t capacity = a->capacity * 2;
+    Slot *slots = calloc(capacity, sizeof(Slot));
+    if (!slots) return 0;
+
+    for (size_t i = 0; i < a->capacity; i++) {
+        Slot *old = &a->slots[i];
+        if (!old->str) continue;
+        *find_slot(slots, capacity, old->str, old->len, fnv1a(old->str, old->len)) = *old;
+    }
+    free(a->slots);
+    a->slots = slots;
+    a->capacity = capacity;
+    return 1;
+}
+
+const char *string_arena_intern(StringArena *a, const char *s, size_t len) {
+    if (len > UINT32_MAX) return string_arena_copy(a, s, len);
+
+    // keep the load factor under 1/2 so probe runs stay short
+    if ((a->count + 1) * 2 > a->capacity && !grow(a)) return NULL;
+
+    uint64_t h = fnv1a(s, len);
+    Slot *slot = find_slot(a->slots, a->capacity, s, len, h);
+    if (slot->str) return slot->str;
+
+    const char *copy = string_arena_copy(a, s, len);
+    if (!copy) return NULL;
+    slot->str = copy;
+    slot->len = (uint32_t)len;
+    slot->tag = (uint32_t)(h >> 32);
+    a->count++;
+    return copy;
+}
+
+size_t string_arena_bytes(const StringArena *a) {
+    return a->bytes;
+}
@@ -0,0 +1,21 @@
+#ifndef STRING_ARENA_H
+#define STRING_ARENA_H
+
+#include <stddef.h>
+
+// append-only storage for NUL-terminated strings. strings are packed into large
+// blocks that are never moved, so returned pointers stay valid until the arena is
+// freed, and interned strings are stored once however often they are added
+typedef struct StringArena StringArena;
+
+StringArena *string_arena_create(size_t expected_strings);
+void string_arena_free(StringArena *a);
+
+// copies s[0..len) and appends a NUL; NULL on allocation failure
+const char *string_arena_copy(StringArena *a, const char *s, size_t len);
+// like string_arena_copy, but returns the existing copy if an equal string was interned before
+const char *string_arena_intern(StringArena *a, const char *s, size_t len);
+
+size_t string_arena_bytes(const StringArena *a);
+
+#endif
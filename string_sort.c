@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "string_sort.h"
+
+#define INSERTION_SORT_MAX 32     // ranges this small are finished by insertion sort
+#define SHARED_TASK_MIN 16384     // ranges this large are offered to other threads
+#define PARALLEL_MIN 65536        // below this a single thread is faster
+#define MAX_THREADS 16
+
+typedef struct {
+    size_t lo, hi;  // order[lo, hi) share their first depth bytes
+    size_t depth;
+} Task;
+
+typedef struct {
+    Task *items;
+    size_t count, cap;
+} TaskStack;
+
+typedef struct {
+    const char *pool;
+    const uint32_t *offsets;
+    uint32_t *order;
+    uint32_t *tmp;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    TaskStack shared;
+    int busy;  // threads holding a task taken from the shared stack
+    int failed;
+} Sorter;
+
+static int push_task(TaskStack *s, size_t lo, size_t hi, size_t depth) {
+    if (s->count == s->cap) {
+        size_t cap = s->cap ? s->cap * 2 : 256;
+        Task *items = realloc(s->items, cap * sizeof(*items));
+        if (!items) return 0;
+        s->items = items;
+        s->cap = cap;
+    }
+    s->items[s->count++] = (Task){ lo, hi, depth };
+    return 1;
+}
+
+static const char *key_of(const Sorter *st, uint32_t index) {
+    return st->pool + st->offsets[index];
+}
+
+static void insertion_sort(const Sorter *st, uint32_t *order, size_t n, size_t depth) {
+    for (size_t i = 1; i < n; i++) {
+        uint32_t v = order[i];
+        const char *key = key_of(st, v) + depth;
+        size_t j = i;
+        while (j > 0 && strcmp(key_of(st, order[j - 1]) + depth, key) > 0) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = v;
+    }
+}
+
+// distributes one range on its depth-th byte; strings that end here are already in place
+static int split_range(Sorter *st, const Task *t, TaskStack *local) {
+    size_t count[256] = {0}, start[256];
+    uint32_t *order = st->order, *tmp = st->tmp;
+
+    for (size_t i = t->lo; i < t->hi; i++) {
+        count[(unsigned char)key_of(st, order[i])[t->depth]]++;
+    }
+    size_t pos = t->lo;
+    for (int b = 0; b < 256; b++) {
+        start[b] = pos;
+        pos += count[b];
+    }
+    for (size_t i = t->lo; i < t->hi; i++) {
+        uint32_t v = order[i];
+        tmp[start[(unsigned char)key_of(st, v)[t->depth]]++] = v;
+    }
+    memcpy(order + t->lo, tmp + t->lo, (t->hi - t->lo) * sizeof(*order));
+
+    // start[b] now marks the end of bucket b
+    for (int b = 1; b < 256; b++) {
+        size_t lo = start[b] - count[b], hi = start[b];
+        if (hi - lo < 2) continue;
+        if (hi - lo <= INSERTION_SORT_MAX) {
+            insertion_sort(st, order + lo, hi - lo, t->depth + 1);
+            continue;
+        }
+
+        if (hi - lo >= SHARED_TASK_MIN) {
+            pthread_mutex_lock(&st->lock);
+            int ok = push_task(&st->shared, lo, hi, t->depth + 1);
+            pthread_cond_signal(&st->work);
+            pthread_mutex_unlock(&st->lock);
+            if (ok) continue;
+        }
+        if (!push_task(local, lo, hi, t->depth + 1)) return 0;
+    }
+    return 1;
+}
+
+static void *sort_worker(void *arg) {
+    Sorter *st = arg;
+    TaskStack local = { NULL, 0, 0 };
+
+    pthread_mutex_lock(&st->lock);
+    while (1) {
+        while (st->shared.count == 0 && st->busy > 0 && !st->failed) {
+            pthread_cond_wait(&st->work, &st->lock);
+        }
+        if (st->shared.count == 0 || st->failed) break;
+        Task t = st->shared.items[--st->shared.count];
+        st->busy++;
+        pthread_mutex_unlock(&st->lock);
+
+        // small pieces of the task stay on this thread's own stack
+        int ok = split_range(st, &t, &local);
+        while (ok && local.count > 0) {
+            Task sub = local.items[--local.count];
+            ok = split_range(st, &sub, &local);
+        }
+        local.count = 0;
+
+        pthread_mutex_lock(&st->lock);
+        if (!ok) st->failed = 1;
+        st->busy--;
+        if (st->busy == 0 || st->failed) pthread_cond_broadcast(&st->work);
+    }
+    pthread_cond_broadcast(&st->work);
+    pthread_mutex_unlock(&st->lock);
+
+    free(local.items);
+    return NULL;
+}
+
+int string_sort(uint32_t *order, size_t n, const char *pool, const uint32_t *offsets, int max_threads) {
+    if (n < 2) return 1;
+
+    Sorter st = { pool, offsets, order, NULL };
+    if (n <= INSERTION_SORT_MAX) {
+        insertion_sort(&st, order, n, 0);
+        return 1;
+    }
+
+    st.tmp = malloc(n * sizeof(*st.tmp));
+    if (!st.tmp || !push_task(&st.shared, 0, n, 0)) {
+        free(st.tmp);
+        return 0;
+    }
+    pthread_mutex_init(&st.lock, NULL);
+    pthread_cond_init(&st.work, NULL);
+
+    int threads = n >= PARALLEL_MIN ? max_threads : 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    pthread_t helpers[MAX_THREADS];
+    int started = 0;
+    while (started < threads - 1 && pthread_create(&helpers[started], NULL, sort_worker, &st) == 0) {
+        started++;
+    }
+    sort_worker(&st);
+    for (int i = 0; i < started; i++) pthread_join(helpers[i], NULL);
+
+    pthread_cond_destroy(&st.work);
+    pthread_mutex_destroy(&st.lock);
+    free(st.shared.items);
+    free(st.tmp);
+    return !st.failed;
+}
@@ -0,0 +1,14 @@
+#ifndef STRING_SORT_H
+#define STRING_SORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// stable MSD radix sort of an index permutation by the NUL-terminated strings
+// pool + offsets[order[i]]. it keeps its work on explicit stacks rather than
+// recursing, so the input order cannot exhaust the call stack, and spreads
+// large inputs over up to max_threads threads. returns 0 if memory runs out,
+// leaving order a permutation of its input
+int string_sort(uint32_t *order, size_t n, const char *pool, const uint32_t *offsets, int max_threads);
+
+#endif
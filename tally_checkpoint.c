@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <unistd.h>
+#include "crc32.h"
+#include "tally_checkpoint.h"
+
+#define CHECKPOINT_MAGIC "EVTC"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_SIZE 48  // magic, version, four u64 fields, crc
+
+static void put_le64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static uint64_t get_le64(const unsigned char *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+static void fsync_parent_dir(const char *path) {
+    char *copy = strdup(path);
+    if (!copy) return;
+    int dfd = open(dirname(copy), O_RDONLY | O_DIRECTORY);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
+    free(copy);
+}
+
+int tally_checkpoint_write(const char *path, const TallyCheckpoint *cp) {
+    unsigned char buf[CHECKPOINT_SIZE] = {0};
+    memcpy(buf, CHECKPOINT_MAGIC, 4);
+    buf[4] = CHECKPOINT_VERSION;
+    put_le64(buf + 8, cp->key_id);
+    put_le64(buf + 16, cp->c_tally);
+    put_le64(buf + 24, cp->valid_votes);
+    put_le64(buf + 32, cp->last_seq);
+    uint32_t crc = crc32_update(0, buf, 40);
+    for (int i = 0; i < 4; i++) buf[40 + i] = (unsigned char)(crc >> (8 * i));
+
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        perror("open tally checkpoint");
+        return 0;
+    }
+
+    ssize_t n;
+    do {
+        n = write(fd, buf, sizeof(buf));
+    } while (n < 0 && errno == EINTR);
+    int ok = n == (ssize_t)sizeof(buf) && fsync(fd) == 0;
+    if (close(fd) != 0) ok = 0;
+    if (!ok || rename(tmp_path, path) != 0) {
+        perror("write tally checkpoint");
+        unlink(tmp_path);
+        return 0;
+    }
+
+    fsync_parent_dir(path);
+    return 1;
+}
+
+int tally_checkpoint_read(const char *path, TallyCheckpoint *cp) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    unsigned char buf[CHECKPOINT_SIZE];
+    ssize_t n = read(fd, buf, sizeof(buf));
+    close(fd);
+    if (n != (ssize_t)sizeof(buf) || memcmp(buf, CHECKPOINT_MAGIC, 4) != 0 || buf[4] != CHECKPOINT_VERSION) {
+        fprintf(stderr, "Ignoring unreadable tally checkpoint %s\n", path);
+        return 0;
+    }
+
+    uint32_t crc = 0;
+    for (int i = 3; i >= 0; i--) crc = (crc << 8) | buf[40 + i];
+    if (crc != crc32_update(0, buf, 40)) {
+        fprintf(stderr, "Ignoring corrupt tally checkpoint %s\n", path);
+        return 0;
+    }
+
+    cp->key_id = get_le64(buf + 8);
+    cp->c_tally = get_le64(buf + 16);
+    cp->valid_votes = get_le64(buf + 24);
+    cp->last_seq = get_le64(buf + 32);
+    return 1;
+}
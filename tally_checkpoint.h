@@ -0,0 +1,20 @@
+#ifndef TALLY_CHECKPOINT_H
+#define TALLY_CHECKPOINT_H
+
+#include <stdint.h>
+
+// running encrypted tally as of ballot log sequence number last_seq; on restart
+// voting resumes from it and replays only the log records after last_seq
+typedef struct {
+    uint64_t key_id;       // paillier_key_id of the key the tally is encrypted under
+    uint64_t c_tally;
+    uint64_t valid_votes;
+    uint64_t last_seq;
+} TallyCheckpoint;
+
+// writes a temporary file, fsyncs it and renames it over path
+int tally_checkpoint_write(const char *path, const TallyCheckpoint *cp);
+// 1 if a valid checkpoint was read, 0 if there is none or it is damaged
+int tally_checkpoint_read(const char *path, TallyCheckpoint *cp);
+
+#endif
@@ -0,0 +1,93 @@
+#include <string.h>
+#include "timer_wheel.h"
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define MAX_AHEAD ((uint64_t)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+void timer_wheel_init(TimerWheel *w, uint64_t now) {
+    memset(w, 0, sizeof(*w));
+    w->now = now;
+}
+
+// earliest is the first tick whose slot has not been processed yet
+static void link_node(TimerWheel *w, TimerNode *node, uint64_t earliest) {
+    uint64_t expires = node->expires < earliest ? earliest : node->expires;
+    uint64_t ahead = expires - w->now;
+    if (ahead >= MAX_AHEAD) {
+        // parked in the top level; it is re-bucketed when that slot comes round
+        ahead = MAX_AHEAD - 1;
+        expires = w->now + ahead;
+    }
+
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && ahead >= (uint64_t)1 << (TIMER_WHEEL_BITS * (level + 1))) level++;
+    TimerNode **slot = &w->slots[level][(expires >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK];
+
+    node->next = *slot;
+    if (node->next) node->next->pprev = &node->next;
+    node->pprev = slot;
+    *slot = node;
+}
+
+static void unlink_node(TimerNode *node) {
+    *node->pprev = node->next;
+    if (node->next) node->next->pprev = node->pprev;
+    node->next = NULL;
+    node->pprev = NULL;
+}
+
+void timer_wheel_add(TimerWheel *w, TimerNode *node, uint64_t expires) {
+    if (node->pprev) {
+        unlink_node(node);
+    } else {
+        w->count++;
+    }
+    node->expires = expires;
+    link_node(w, node, w->now + 1);
+}
+
+void timer_wheel_remove(TimerWheel *w, TimerNode *node) {
+    if (!node->pprev) return;
+    unlink_node(node);
+    w->count--;
+}
+
+int timer_wheel_armed(const TimerNode *node) {
+    return node->pprev != NULL;
+}
+
+// moves every node of one upper-level slot down to the level its deadline now falls in
+static void cascade(TimerWheel *w, int level, size_t index) {
+    TimerNode *node = w->slots[level][index];
+    w->slots[level][index] = NULL;
+    while (node) {
+        TimerNode *next = node->next;
+        // cascading runs before the current tick's slot fires, so nodes due now still make it
+        link_node(w, node, w->now);
+        node = next;
+    }
+}
+
+void timer_wheel_advance(TimerWheel *w, uint64_t now, void (*fire)(TimerNode *node, void *arg), void *arg) {
+    while (w->now < now) {
+        uint64_t t = ++w->now;
+        for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            if (t & (((uint64_t)1 << (TIMER_WHEEL_BITS * level)) - 1)) break;
+            cascade(w, level, (t >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK);
+        }
+
+        TimerNode **slot = &w->slots[0][t & SLOT_MASK];
+        while (*slot) {
+            TimerNode *node = *slot;
+            unlink_node(node);
+            w->count--;
+            if (node->expires > t) {
+                // parked beyond the wheel's range; still not due
+                w->count++;
+                link_node(w, node, t + 1);
+                continue;
+            }
+            fire(node, arg);
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// hierarchical timer wheel: 4 levels of 64 slots, so deadlines up to 64^4
+// ticks ahead are kept in buckets rather than sorted. adding, cancelling and
+// each tick are O(1); a timer is re-bucketed at most 3 times on its way down
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+// embedded in the object that owns the deadline
+typedef struct TimerNode {
+    struct TimerNode *next;
+    struct TimerNode **pprev;  // NULL while not armed
+    uint64_t expires;
+} TimerNode;
+
+typedef struct {
+    uint64_t now;
+    size_t count;
+    TimerNode *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+} TimerWheel;
+
+void timer_wheel_init(TimerWheel *w, uint64_t now);
+// arms or re-arms the node; a deadline that has already passed fires on the next tick
+void timer_wheel_add(TimerWheel *w, TimerNode *node, uint64_t expires);
+void timer_wheel_remove(TimerWheel *w, TimerNode *node);
+int timer_wheel_armed(const TimerNode *node);
+
+// runs every tick up to now, unlinking each expired node before calling fire,
+// so fire may free the node or arm it again
+void timer_wheel_advance(TimerWheel *w, uint64_t now, void (*fire)(TimerNode *node, void *arg), void *arg);
+
+#endif
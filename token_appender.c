@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "token_appender.h"
+
+#define HEX_RECORD_BYTES (2 * TOKEN_APPENDER_KEY_BYTES + 1)
+#define RECOVERY_CHUNK 4096
+
+struct TokenAppender {
+    int fd;
+    TokenAppendFormat format;
+    TokenAppendPolicy policy;
+    size_t record_bytes;
+
+    unsigned char *buf;  // reused for every batch of records
+    size_t buf_records;
+    size_t buf_written;  // leading bytes of buf already on disk after a short or failed write
+    off_t size;          // file length as written through this appender
+
+    int unsynced;  // records written but not yet fdatasync'd
+    struct timespec oldest_unsynced;
+};
+
+static long long elapsed_ms(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)(now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+// where the last complete record ends: a multiple of the record size for
+// binary output, just past the last newline for hex
+static off_t complete_length(int fd, TokenAppendFormat format, off_t size) {
+    if (format == TOKEN_APPEND_BINARY) {
+        return size - size % TOKEN_APPENDER_KEY_BYTES;
+    }
+
+    unsigned char chunk[RECOVERY_CHUNK];
+    off_t end = size;
+    while (end > 0) {
+        size_t len = end < RECOVERY_CHUNK ? (size_t)end : RECOVERY_CHUNK;
+        if (pread(fd, chunk, len, end - (off_t)len) != (ssize_t)len) return -1;
+        for (size_t i = len; i > 0; i--) {
+            if (chunk[i - 1] == '\n') return end - (off_t)len + (off_t)i;
+        }
+        end -= (off_t)len;
+    }
+    return 0;
+}
+
+TokenAppender *token_appender_open(const char *path, TokenAppendFormat format, const TokenAppendPolicy *policy) {
+    TokenAppender *a = calloc(1, sizeof(*a));
+    if (!a) return NULL;
+
+    a->format = format;
+    a->policy = *policy;
+    if (a->policy.buffer_records == 0) a->policy.buffer_records = 1;
+    a->record_bytes = format == TOKEN_APPEND_HEX ? HEX_RECORD_BYTES : TOKEN_APPENDER_KEY_BYTES;
+    a->buf = malloc(a->policy.buffer_records * a->record_bytes);
+    if (!a->buf) {
+        free(a);
+        return NULL;
+    }
+
+    a->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+    if (a->fd < 0) {
+        perror("open token output");
+        goto fail;
+    }
+
+    // the recovery scan needs to read, so use a second descriptor for it
+    int rfd = open(path, O_RDONLY);
+    struct stat st;
+    if (rfd < 0 || fstat(rfd, &st) != 0) {
+        if (rfd >= 0) close(rfd);
+        goto fail;
+    }
+    off_t keep = complete_length(rfd, format, st.st_size);
+    close(rfd);
+    if (keep < 0) goto fail;
+    if (keep != st.st_size) {
+        fprintf(stderr, "%s: dropping %lld bytes of a torn final record\n", path, (long long)(st.st_size - keep));
+        if (ftruncate(a->fd, keep) != 0 || fdatasync(a->fd) != 0) {
+            perror("truncate token output");
+            goto fail;
+        }
+    }
+    a->size = keep;
+    return a;
+
+fail:
+    if (a->fd >= 0) close(a->fd);
+    free(a->buf);
+    free(a);
+    return NULL;
+}
+
+// resumes where an earlier failed write stopped, so no record is written twice
+static int write_buffer(TokenAppender *a) {
+    size_t len = a->buf_records * a->record_bytes;
+    while (a->buf_written < len) {
+        ssize_t n = write(a->fd, a->buf + a->buf_written, len - a->buf_written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("write token output");
+            return 0;
+        }
+        if (!a->unsynced) clock_gettime(CLOCK_MONOTONIC, &a->oldest_unsynced);
+        a->unsynced = 1;
+        a->buf_written += (size_t)n;
+        a->size += n;
+    }
+    a->buf_records = 0;
+    a->buf_written = 0;
+    return 1;
+}
+
+int token_appender_sync(TokenAppender *a) {
+    if (!write_buffer(a)) return 0;
+    if (!a->unsynced) return 1;
+    if (fdatasync(a->fd) != 0) {
+        perror("fdatasync token output");
+        return 0;
+    }
+    a->unsynced = 0;
+    return 1;
+}
+
+int token_appender_poll(TokenAppender *a) {
+    if (a->unsynced && elapsed_ms(&a->oldest_unsynced) >= a->policy.sync_ms) {
+        return token_appender_sync(a);
+    }
+    return 1;
+}
+
+int token_appender_drop_last(TokenAppender *a) {
+    // the last record ends wherever the buffered records would end on disk
+    off_t start = a->size + (off_t)(a->buf_records * a->record_bytes - a->buf_written) - (off_t)a->record_bytes;
+    if (a->size > start) {
+        if (ftruncate(a->fd, start) != 0) {
+            perror("truncate token output");
+            return 0;
+        }
+        a->size = start;
+    }
+    if (a->buf_records > 0) {
+        a->buf_records--;
+        if (a->buf_written > a->buf_records * a->record_bytes) a->buf_written = a->buf_records * a->record_bytes;
+    }
+    return 1;
+}
+
+int token_appender_add(TokenAppender *a, const unsigned char key[TOKEN_APPENDER_KEY_BYTES]) {
+    // a full buffer means an earlier write failed; it has to drain before there is room
+    if (a->buf_records == a->policy.buffer_records && !write_buffer(a)) return 0;
+
+    unsigned char *rec = a->buf + a->buf_records * a->record_bytes;
+    if (a->format == TOKEN_APPEND_HEX) {
+        static const char digits[] = "0123456789abcdef";
+        for (int i = 0; i < TOKEN_APPENDER_KEY_BYTES; i++) {
+            rec[2 * i] = digits[key[i] >> 4];
+            rec[2 * i + 1] = digits[key[i] & 0x0f];
+        }
+        rec[2 * TOKEN_APPENDER_KEY_BYTES] = '\n';
+    } else {
+        memcpy(rec, key, TOKEN_APPENDER_KEY_BYTES);
+    }
+
+    if (++a->buf_records < a->policy.buffer_records) return 1;
+    if (write_buffer(a) && token_appender_poll(a)) return 1;
+    // take this record back out so a failed add leaves none of it in the file;
+    // earlier records stay buffered for the next write
+    token_appender_drop_last(a);
+    return 0;
+}
+
+int token_appender_close(TokenAppender *a) {
+    if (!a) return 1;
+    int ok = token_appender_sync(a);
+    if (close(a->fd) != 0) ok = 0;
+    free(a->buf);
+    free(a);
+    return ok;
+}
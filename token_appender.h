@@ -0,0 +1,39 @@
+#ifndef TOKEN_APPENDER_H
+#define TOKEN_APPENDER_H
+
+#include <stddef.h>
+
+#define TOKEN_APPENDER_KEY_BYTES 32
+
+// hex writes one lowercase line per token (tokens.txt), binary writes the raw
+// 32-byte hash (the token store stage)
+typedef enum {
+    TOKEN_APPEND_HEX,
+    TOKEN_APPEND_BINARY,
+} TokenAppendFormat;
+
+typedef struct {
+    size_t buffer_records;  // records gathered before one write(); 1 writes through
+    unsigned int sync_ms;   // fdatasync once the oldest unsynced record is this old; 0 syncs every write
+} TokenAppendPolicy;
+
+// keeps the output file open across tokens instead of reopening it per student
+typedef struct TokenAppender TokenAppender;
+
+// opens path for appending, first cutting off a torn final record left by a crash
+TokenAppender *token_appender_open(const char *path, TokenAppendFormat format, const TokenAppendPolicy *policy);
+// syncs anything outstanding, then closes; 0 if data may have been lost
+int token_appender_close(TokenAppender *a);
+
+// 0 if the record could not be written or synced; none of it is left in the file then
+int token_appender_add(TokenAppender *a, const unsigned char key[TOKEN_APPENDER_KEY_BYTES]);
+// takes back the record from the last successful add, e.g. when its twin in
+// another output failed; call at most once per add
+int token_appender_drop_last(TokenAppender *a);
+// syncs if the durability window has run out; call when idle so a quiet
+// period does not leave records unsynced
+int token_appender_poll(TokenAppender *a);
+// writes the buffer and fdatasyncs now
+int token_appender_sync(TokenAppender *a);
+
+#endif
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <openssl/bn.h>
+#include "wire.h"
+#include "token_generation.h"
+
+#define TOKEN_HASH_BYTES 32
+
+static int server_fd = -1;
+
+// the authority's signing step happens on the other side of the socket
+int system_blind_sign(const BIGNUM *m_blinded, BIGNUM **s_blinded_out) {
+    if (!wire_send_bn(server_fd, WIRE_MSG_BLIND_REQ, m_blinded)) return 0;
+
+    unsigned char buf[WIRE_MAX_PAYLOAD];
+    uint8_t type;
+    uint32_t len;
+    if (!wire_recv(server_fd, &type, buf, sizeof(buf), &len)) return 0;
+
+    if (type == WIRE_MSG_STATUS && len > 0) {
+        fprintf(stderr, "Server refused to sign: %.*s\n", (int)(len - 1), (const char *)buf + 1);
+        return 0;
+    }
+    if (type != WIRE_MSG_BLIND_SIG) return 0;
+
+    *s_blinded_out = BN_bin2bn(buf, (int)len, NULL);
+    return *s_blinded_out != NULL;
+}
+
+// returns the status byte sent by the server, or -1 on protocol error
+static int expect_status(void) {
+    unsigned char buf[WIRE_MAX_PAYLOAD];
+    uint8_t type;
+    uint32_t len;
+    if (!wire_recv(server_fd, &type, buf, sizeof(buf), &len) || type != WIRE_MSG_STATUS || len == 0) {
+        fprintf(stderr, "Connection to registration system lost\n");
+        return -1;
+    }
+    if (len > 1) {
+        printf("%.*s\n", (int)(len - 1), (const char *)buf + 1);
+    }
+    return buf[0];
+}
+
+static int read_line(const char *prompt, char *buf, size_t cap) {
+    printf("%s", prompt);
+    fflush(stdout);
+    if (!fgets(buf, (int)cap, stdin)) return 0;
+
+    size_t len = strlen(buf);
+    while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r')) {
+        buf[--len] = '\0';
+    }
+    return len > 0;
+}
+
+static int hex_to_bytes(const char *hex, unsigned char *out, size_t out_len) {
+    if (strlen(hex) != out_len * 2) return 0;
+    for (size_t i = 0; i < out_len; i++) {
+        unsigned int byte;
+        if (sscanf(hex + 2 * i, "%2x", &byte) != 1) return 0;
+        out[i] = (unsigned char)byte;
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr,
+                "Usage: %s <socket_path>\n"
+                "  socket_path: Unix socket of the registration system (system --listen).\n",
+                argv[0]);
+        return 1;
+    }
+
+    server_fd = wire_connect_unix(argv[1]);
+    if (server_fd < 0) {
+        fprintf(stderr, "Cannot connect to registration system at %s\n", argv[1]);
+        return 1;
+    }
+
+    int rc = 1;
+    BIGNUM *N = NULL;
+    BIGNUM *e = NULL;
+    char *token_hex = NULL;
+    TokenPrefetch *prefetch = NULL;
+    TokenRequest *req = NULL;
+
+    unsigned char buf[WIRE_MAX_PAYLOAD];
+    uint8_t type;
+    uint32_t len;
+    if (!wire_recv(server_fd, &type, buf, sizeof(buf), &len) || type != WIRE_MSG_PUBKEY ||
+        !wire_parse_pubkey(buf, len, &N, &e)) {
+        fprintf(stderr, "Failed to receive the registration public key\n");
+        goto done;
+    }
+
+    char line[256];
+    if (!read_line("Enter student ID: ", line, sizeof(line))) goto done;
+    if (!wire_send(server_fd, WIRE_MSG_AUTH_ID, line, (uint32_t)strlen(line))) goto done;
+    if (expect_status() != WIRE_STATUS_OK) goto done;
+
+    if (!token_generation_init(N, e)) goto done;
+
+    // prepare the token while the student reads the email and types the code
+    prefetch = token_prefetch_start(N, e);
+
+    if (!read_line("Enter the 6-digit verification code: ", line, sizeof(line))) goto done;
+    if (!wire_send(server_fd, WIRE_MSG_AUTH_CODE, line, (uint32_t)strlen(line))) goto done;
+    if (expect_status() != WIRE_STATUS_OK) goto done;
+
+    req = token_prefetch_join(prefetch);
+    prefetch = NULL;
+    if (!req) {
+        req = token_request_prepare(N, e);
+    }
+
+    if (!req || token_request_finish(req, N, e, &token_hex) != 0 || !token_hex) {
+        fprintf(stderr, "Token generation failed\n");
+        goto done;
+    }
+
+    unsigned char token_hash[TOKEN_HASH_BYTES];
+    if (!hex_to_bytes(token_hex, token_hash, sizeof(token_hash))) goto done;
+    if (!wire_send(server_fd, WIRE_MSG_TOKEN_COMMIT, token_hash, sizeof(token_hash))) goto done;
+    if (expect_status() != WIRE_STATUS_OK) goto done;
+
+    rc = 0;
+
+done:
+    token_prefetch_discard(prefetch);
+    token_request_free(req);
+    token_generation_cleanup();
+    free(token_hex);
+    BN_free(N);
+    BN_free(e);
+    close(server_fd);
+    return rc;
+}
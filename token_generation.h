@@ -1,8 +1,39 @@
 #ifndef TOKEN_GENERATION_H
 #define TOKEN_GENERATION_H
 
+#include <stdio.h>
+#include <stdint.h>
 #include <openssl/bn.h>
 
+// batch output: 20-byte header ("EVTB", u32 version, u64 count, u32 sig_len, big-endian)
+// followed by count records of nonce[16] || token_hash[32] || signature[sig_len]
+#define TOKEN_BATCH_MAGIC "EVTB"
+#define TOKEN_BATCH_VERSION 1
+#define TOKEN_BATCH_HEADER_SIZE 20
+#define TOKEN_BATCH_NONCE_BYTES 16
+#define TOKEN_BATCH_HASH_BYTES 32
+
+int token_generation_init(const BIGNUM *g_public_n, const BIGNUM *g_public_e);
+void token_generation_cleanup(void);
 int run_token_generation(const BIGNUM *g_public_n, const BIGNUM *g_public_e, char **token_out);
 
+// run_token_generation split in two: prepare does the nonce, hash and blinding,
+// finish asks the authority to sign and then unblinds and verifies
+typedef struct TokenRequest TokenRequest;
+TokenRequest *token_request_prepare(const BIGNUM *g_public_n, const BIGNUM *g_public_e);
+int token_request_finish(TokenRequest *req, const BIGNUM *g_public_n, const BIGNUM *g_public_e, char **token_out);
+void token_request_free(TokenRequest *req);
+
+// speculative prepare on a background thread, e.g. while the student types the
+// verification code. the key must stay alive until the prefetch is joined or finished.
+typedef struct TokenPrefetch TokenPrefetch;
+TokenPrefetch *token_prefetch_start(const BIGNUM *g_public_n, const BIGNUM *g_public_e);
+TokenRequest *token_prefetch_join(TokenPrefetch *prefetch);
+void token_prefetch_discard(TokenPrefetch *prefetch);
+
+int run_token_generation_batch(const BIGNUM *g_public_n, const BIGNUM *g_public_e, size_t count, FILE *tokens_out);
+int token_batch_read_header(FILE *in, uint64_t *count_out, uint32_t *sig_len_out);
+int token_batch_read_record(FILE *in, uint32_t sig_len, unsigned char nonce[TOKEN_BATCH_NONCE_BYTES],
+                            unsigned char token_hash[TOKEN_BATCH_HASH_BYTES], unsigned char *sig);
+
 #endif
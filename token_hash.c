@@ -0,0 +1,388 @@
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <openssl/sha.h>
+#include "token_hash.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define TOKEN_HASH_X86 1
+#endif
+
+#define AVX2_LANES 8
+#define VERIFY_CHUNK 64
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t H0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+// everything about SHA-256(prefix || nonce) that does not depend on the nonce
+typedef struct {
+    int single_block;         // 0 if the nonce and padding spill into a second block
+    uint32_t chain[8];        // state after the prefix's whole 64-byte blocks
+    unsigned char block[64];  // padded last block, zeros where the nonce goes
+    uint32_t w[16];           // the same block as message words
+    size_t nonce_at;          // byte offset of the nonce in block
+    int first_nonce_word, last_nonce_word;
+    int first_round;          // rounds before this read only prefix words...
+    uint32_t round_state[8];  // ...and leave the working variables here
+    int sha_groups;           // whole 4-round groups before first_round, for SHA-NI
+    uint32_t sha_state[8];    // working variables after those groups
+} Template;
+
+typedef void (*HashManyFn)(const Template *t, const unsigned char *nonces, unsigned char *hashes, size_t n);
+
+typedef struct {
+    const char *name;
+    HashManyFn fn;
+    int (*supported)(void);
+} Backend;
+
+static Template tmpl;
+static const Backend *backend;
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+static uint32_t load_be32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static void store_be32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static uint32_t rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+// runs rounds [from, to) on the working variables s; w is the 16-word schedule window
+static void scalar_rounds(uint32_t s[8], uint32_t w[16], int from, int to) {
+    uint32_t a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int r = from; r < to; r++) {
+        if (r >= 16) {
+            uint32_t w15 = w[(r - 15) & 15], w2 = w[(r - 2) & 15];
+            uint32_t s0 = rotr(w15, 7) ^ rotr(w15, 18) ^ (w15 >> 3);
+            uint32_t s1 = rotr(w2, 17) ^ rotr(w2, 19) ^ (w2 >> 10);
+            w[r & 15] += s0 + w[(r - 7) & 15] + s1;
+        }
+        uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[r] + w[r & 15];
+        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    s[0] = a; s[1] = b; s[2] = c; s[3] = d; s[4] = e; s[5] = f; s[6] = g; s[7] = h;
+}
+
+static void build_template(void) {
+    const unsigned char *prefix = (const unsigned char *)ELECTION_ID;
+    size_t len = strlen(ELECTION_ID);
+    size_t tail = len % 64;
+
+    memcpy(tmpl.chain, H0, sizeof(H0));
+    for (size_t off = 0; off + 64 <= len; off += 64) {
+        uint32_t w[16], s[8];
+        for (int i = 0; i < 16; i++) w[i] = load_be32(prefix + off + 4 * i);
+        memcpy(s, tmpl.chain, sizeof(s));
+        scalar_rounds(s, w, 0, 64);
+        for (int i = 0; i < 8; i++) tmpl.chain[i] += s[i];
+    }
+
+    // nonce, the 0x80 marker and the 64-bit length must share the last block
+    tmpl.single_block = tail + TOKEN_HASH_NONCE_BYTES + 9 <= 64;
+    if (!tmpl.single_block) return;
+
+    memset(tmpl.block, 0, sizeof(tmpl.block));
+    memcpy(tmpl.block, prefix + len - tail, tail);
+    tmpl.nonce_at = tail;
+    tmpl.block[tail + TOKEN_HASH_NONCE_BYTES] = 0x80;
+    uint64_t bits = (uint64_t)(len + TOKEN_HASH_NONCE_BYTES) * 8;
+    store_be32(tmpl.block + 56, (uint32_t)(bits >> 32));
+    store_be32(tmpl.block + 60, (uint32_t)bits);
+    for (int i = 0; i < 16; i++) tmpl.w[i] = load_be32(tmpl.block + 4 * i);
+
+    tmpl.first_nonce_word = (int)(tail / 4);
+    tmpl.last_nonce_word = (int)((tail + TOKEN_HASH_NONCE_BYTES - 1) / 4);
+    tmpl.first_round = tmpl.first_nonce_word;
+    tmpl.sha_groups = tmpl.first_round / 4;
+
+    uint32_t w[16];
+    memcpy(w, tmpl.w, sizeof(w));
+    memcpy(tmpl.sha_state, tmpl.chain, sizeof(tmpl.chain));
+    scalar_rounds(tmpl.sha_state, w, 0, tmpl.sha_groups * 4);
+    memcpy(tmpl.round_state, tmpl.sha_state, sizeof(tmpl.sha_state));
+    scalar_rounds(tmpl.round_state, w, tmpl.sha_groups * 4, tmpl.first_round);
+}
+
+// the prefix is too long for the single-block template: plain one-shot hashing
+static void hash_many_generic(const Template *t, const unsigned char *nonces, unsigned char *hashes, size_t n) {
+    (void)t;
+    size_t len = strlen(ELECTION_ID);
+    unsigned char buf[256];
+    for (size_t i = 0; i < n; i++) {
+        memcpy(buf, ELECTION_ID, len);
+        memcpy(buf + len, nonces + i * TOKEN_HASH_NONCE_BYTES, TOKEN_HASH_NONCE_BYTES);
+        SHA256(buf, len + TOKEN_HASH_NONCE_BYTES, hashes + i * TOKEN_HASH_BYTES);
+    }
+}
+
+static void hash_many_portable(const Template *t, const unsigned char *nonces, unsigned char *hashes, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        uint32_t w[16], s[8];
+        memcpy(w, t->w, sizeof(w));
+        const unsigned char *nonce = nonces + i * TOKEN_HASH_NONCE_BYTES;
+        unsigned char block[64];
+        memcpy(block, t->block, sizeof(block));
+        memcpy(block + t->nonce_at, nonce, TOKEN_HASH_NONCE_BYTES);
+        for (int k = t->first_nonce_word; k <= t->last_nonce_word; k++) w[k] = load_be32(block + 4 * k);
+
+        memcpy(s, t->round_state, sizeof(s));
+        scalar_rounds(s, w, t->first_round, 64);
+        for (int k = 0; k < 8; k++) store_be32(hashes + i * TOKEN_HASH_BYTES + 4 * k, t->chain[k] + s[k]);
+    }
+}
+
+static int always_supported(void) {
+    return 1;
+}
+
+#ifdef TOKEN_HASH_X86
+
+static int cpu_has_avx2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+static int cpu_has_sha(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return 0;
+    __builtin_cpu_init();
+    // SHA-NI itself is leaf 7 EBX bit 29; the state shuffles need SSE4.1
+    return (ebx & (1u << 29)) && __builtin_cpu_supports("sse4.1");
+}
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+#define V_ROTR(x, n) _mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+
+// eight tokens per pass, one per 32-bit lane
+AVX2_TARGET static void hash8_avx2(const Template *t, const unsigned char *nonces, unsigned char *hashes) {
+    uint32_t lanes[16][AVX2_LANES] __attribute__((aligned(32)));
+    for (int j = 0; j < AVX2_LANES; j++) {
+        unsigned char block[64];
+        memcpy(block, t->block, sizeof(block));
+        memcpy(block + t->nonce_at, nonces + j * TOKEN_HASH_NONCE_BYTES, TOKEN_HASH_NONCE_BYTES);
+        for (int k = t->first_nonce_word; k <= t->last_nonce_word; k++) lanes[k][j] = load_be32(block + 4 * k);
+    }
+
+    __m256i w[16];
+    for (int k = 0; k < 16; k++) {
+        w[k] = (k >= t->first_nonce_word && k <= t->last_nonce_word)
+                   ? _mm256_load_si256((const __m256i *)lanes[k])
+                   : _mm256_set1_epi32((int)t->w[k]);
+    }
+
+    __m256i a = _mm256_set1_epi32((int)t->round_state[0]), b = _mm256_set1_epi32((int)t->round_state[1]);
+    __m256i c = _mm256_set1_epi32((int)t->round_state[2]), d = _mm256_set1_epi32((int)t->round_state[3]);
+    __m256i e = _mm256_set1_epi32((int)t->round_state[4]), f = _mm256_set1_epi32((int)t->round_state[5]);
+    __m256i g = _mm256_set1_epi32((int)t->round_state[6]), h = _mm256_set1_epi32((int)t->round_state[7]);
+
+    for (int r = t->first_round; r < 64; r++) {
+        if (r >= 16) {
+            __m256i w15 = w[(r - 15) & 15], w2 = w[(r - 2) & 15];
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(V_ROTR(w15, 7), V_ROTR(w15, 18)), _mm256_srli_epi32(w15, 3));
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(V_ROTR(w2, 17), V_ROTR(w2, 19)), _mm256_srli_epi32(w2, 10));
+            w[r & 15] = _mm256_add_epi32(_mm256_add_epi32(w[r & 15], s0), _mm256_add_epi32(w[(r - 7) & 15], s1));
+        }
+        __m256i big_s1 = _mm256_xor_si256(_mm256_xor_si256(V_ROTR(e, 6), V_ROTR(e, 11)), V_ROTR(e, 25));
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, big_s1),
+                                      _mm256_add_epi32(_mm256_add_epi32(ch, _mm256_set1_epi32((int)K[r])), w[r & 15]));
+        __m256i big_s0 = _mm256_xor_si256(_mm256_xor_si256(V_ROTR(a, 2), V_ROTR(a, 13)), V_ROTR(a, 22));
+        __m256i maj = _mm256_xor_si256(_mm256_and_si256(a, _mm256_xor_si256(b, c)), _mm256_and_si256(b, c));
+        __m256i t2 = _mm256_add_epi32(big_s0, maj);
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, t2);
+    }
+
+    __m256i out[8] = { a, b, c, d, e, f, g, h };
+    uint32_t words[8][AVX2_LANES] __attribute__((aligned(32)));
+    for (int k = 0; k < 8; k++) {
+        _mm256_store_si256((__m256i *)words[k], _mm256_add_epi32(out[k], _mm256_set1_epi32((int)t->chain[k])));
+    }
+    for (int j = 0; j < AVX2_LANES; j++) {
+        for (int k = 0; k < 8; k++) store_be32(hashes + j * TOKEN_HASH_BYTES + 4 * k, words[k][j]);
+    }
+}
+
+static void hash_many_avx2(const Template *t, const unsigned char *nonces, unsigned char *hashes, size_t n) {
+    size_t i = 0;
+    for (; i + AVX2_LANES <= n; i += AVX2_LANES) {
+        hash8_avx2(t, nonces + i * TOKEN_HASH_NONCE_BYTES, hashes + i * TOKEN_HASH_BYTES);
+    }
+    if (i < n) {
+        // a short last pass runs on zero padding and keeps only the real lanes
+        unsigned char pad_nonces[AVX2_LANES * TOKEN_HASH_NONCE_BYTES] = {0};
+        unsigned char pad_hashes[AVX2_LANES * TOKEN_HASH_BYTES];
+        memcpy(pad_nonces, nonces + i * TOKEN_HASH_NONCE_BYTES, (n - i) * TOKEN_HASH_NONCE_BYTES);
+        hash8_avx2(t, pad_nonces, pad_hashes);
+        memcpy(hashes + i * TOKEN_HASH_BYTES, pad_hashes, (n - i) * TOKEN_HASH_BYTES);
+    }
+}
+
+#define SHA_TARGET __attribute__((target("sha,sse4.1")))
+
+#define SHA_STREAMS 2  // independent blocks in flight, to hide the round instruction's latency
+
+SHA_TARGET static void hash_sha_streams(const Template *t, const unsigned char *nonces, unsigned char *hashes, int streams) {
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+    __m128i msg[SHA_STREAMS][4], state0[SHA_STREAMS], state1[SHA_STREAMS];
+
+    // working variables into the ABEF / CDGH layout the round instruction expects
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)t->sha_state), 0xB1);
+    __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(t->sha_state + 4)), 0x1B);
+    __m128i abef = _mm_alignr_epi8(tmp, efgh, 8);
+    __m128i cdgh = _mm_blend_epi16(efgh, tmp, 0xF0);
+
+    for (int s = 0; s < streams; s++) {
+        unsigned char block[64];
+        memcpy(block, t->block, sizeof(block));
+        memcpy(block + t->nonce_at, nonces + s * TOKEN_HASH_NONCE_BYTES, TOKEN_HASH_NONCE_BYTES);
+        for (int k = 0; k < 4; k++) {
+            msg[s][k] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(block + 16 * k)), bswap);
+        }
+        state0[s] = abef;
+        state1[s] = cdgh;
+    }
+
+    for (int k = 0; k < 16; k++) {
+        __m128i kk = _mm_loadu_si128((const __m128i *)(K + 4 * k));
+        for (int s = 0; s < streams; s++) {
+            if (k >= 4) {
+                __m128i *m = &msg[s][k & 3];
+                __m128i prev = msg[s][(k + 3) & 3];
+                *m = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(*m, msg[s][(k + 1) & 3]),
+                                                        _mm_alignr_epi8(prev, msg[s][(k + 2) & 3], 4)),
+                                          prev);
+            }
+            if (k < t->sha_groups) continue;
+            __m128i wk = _mm_add_epi32(msg[s][k & 3], kk);
+            state1[s] = _mm_sha256rnds2_epu32(state1[s], state0[s], wk);
+            state0[s] = _mm_sha256rnds2_epu32(state0[s], state1[s], _mm_shuffle_epi32(wk, 0x0E));
+        }
+    }
+
+    __m128i chain0 = _mm_loadu_si128((const __m128i *)t->chain);
+    __m128i chain1 = _mm_loadu_si128((const __m128i *)(t->chain + 4));
+    for (int s = 0; s < streams; s++) {
+        tmp = _mm_shuffle_epi32(state0[s], 0x1B);
+        __m128i hgfe = _mm_shuffle_epi32(state1[s], 0xB1);
+        __m128i dcba = _mm_add_epi32(_mm_blend_epi16(tmp, hgfe, 0xF0), chain0);
+        hgfe = _mm_add_epi32(_mm_alignr_epi8(hgfe, tmp, 8), chain1);
+        unsigned char *hash = hashes + s * TOKEN_HASH_BYTES;
+        _mm_storeu_si128((__m128i *)hash, _mm_shuffle_epi8(dcba, bswap));
+        _mm_storeu_si128((__m128i *)(hash + 16), _mm_shuffle_epi8(hgfe, bswap));
+    }
+}
+
+static void hash_many_sha(const Template *t, const unsigned char *nonces, unsigned char *hashes, size_t n) {
+    size_t i = 0;
+    for (; i + SHA_STREAMS <= n; i += SHA_STREAMS) {
+        hash_sha_streams(t, nonces + i * TOKEN_HASH_NONCE_BYTES, hashes + i * TOKEN_HASH_BYTES, SHA_STREAMS);
+    }
+    if (i < n) hash_sha_streams(t, nonces + i * TOKEN_HASH_NONCE_BYTES, hashes + i * TOKEN_HASH_BYTES, (int)(n - i));
+}
+
+#endif
+
+// fastest first
+static const Backend backends[] = {
+#ifdef TOKEN_HASH_X86
+    { "sha-ni", hash_many_sha, cpu_has_sha },
+    { "avx2", hash_many_avx2, cpu_has_avx2 },
+#endif
+    { "portable", hash_many_portable, always_supported },
+};
+
+static const Backend generic_backend = { "generic", hash_many_generic, always_supported };
+
+static void init_backend(void) {
+    build_template();
+    if (!tmpl.single_block) {
+        backend = &generic_backend;
+        return;
+    }
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if (backends[i].supported()) {
+            backend = &backends[i];
+            return;
+        }
+    }
+}
+
+static const Backend *current_backend(void) {
+    pthread_once(&init_once, init_backend);
+    return __atomic_load_n(&backend, __ATOMIC_ACQUIRE);
+}
+
+void token_hash_many(const unsigned char *nonces, unsigned char *hashes, size_t n) {
+    current_backend()->fn(&tmpl, nonces, hashes, n);
+}
+
+void token_hash_one(const unsigned char nonce[TOKEN_HASH_NONCE_BYTES], unsigned char hash[TOKEN_HASH_BYTES]) {
+    token_hash_many(nonce, hash, 1);
+}
+
+size_t token_hash_verify_many(const unsigned char *nonces, const unsigned char *hashes, size_t n, size_t *first_bad) {
+    const Backend *b = current_backend();
+    unsigned char expected[VERIFY_CHUNK * TOKEN_HASH_BYTES];
+    size_t bad = 0;
+    for (size_t i = 0; i < n; i += VERIFY_CHUNK) {
+        size_t m = n - i < VERIFY_CHUNK ? n - i : VERIFY_CHUNK;
+        b->fn(&tmpl, nonces + i * TOKEN_HASH_NONCE_BYTES, expected, m);
+        for (size_t j = 0; j < m; j++) {
+            if (memcmp(expected + j * TOKEN_HASH_BYTES, hashes + (i + j) * TOKEN_HASH_BYTES, TOKEN_HASH_BYTES) == 0) continue;
+            if (bad++ == 0 && first_bad) *first_bad = i + j;
+        }
+    }
+    return bad;
+}
+
+const char *token_hash_backend(void) {
+    return current_backend()->name;
+}
+
+int token_hash_use_backend(const char *name) {
+    if (current_backend() == &generic_backend) return strcmp(name, generic_backend.name) == 0;
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if (strcmp(backends[i].name, name) == 0 && backends[i].supported()) {
+            __atomic_store_n(&backend, &backends[i], __ATOMIC_RELEASE);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,27 @@
+#ifndef TOKEN_HASH_H
+#define TOKEN_HASH_H
+
+#include <stddef.h>
+
+#define ELECTION_ID "AUA_policy_change_vote_2025"
+#define TOKEN_HASH_NONCE_BYTES 16
+#define TOKEN_HASH_BYTES 32
+
+// token hash = SHA-256(ELECTION_ID || nonce). the prefix never changes, so the
+// padded last block is kept as a template with a hole for the nonce, and the
+// compression rounds that only read prefix words are run once up front. what
+// remains per token is the rest of one block, done with SHA-NI, eight tokens
+// per AVX2 pass, or portable C, whichever the CPU supports (picked at runtime)
+
+// nonces holds n * TOKEN_HASH_NONCE_BYTES bytes, hashes gets n * TOKEN_HASH_BYTES; thread-safe
+void token_hash_many(const unsigned char *nonces, unsigned char *hashes, size_t n);
+void token_hash_one(const unsigned char nonce[TOKEN_HASH_NONCE_BYTES], unsigned char hash[TOKEN_HASH_BYTES]);
+// recomputes every hash; returns how many differ and the index of the first in *first_bad
+size_t token_hash_verify_many(const unsigned char *nonces, const unsigned char *hashes, size_t n, size_t *first_bad);
+
+// "sha-ni", "avx2" or "portable"
+const char *token_hash_backend(void);
+// switches to the named backend, e.g. to cross-check them; 0 if this CPU lacks it
+int token_hash_use_backend(const char *name);
+
+#endif
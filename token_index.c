@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "token_index.h"
+
+#define TOKEN_INDEX_MIN_CAPACITY 1024
+
+enum {
+    SLOT_EMPTY = 0,
+    SLOT_LIVE,
+    SLOT_SPENT,
+};
+
+typedef struct {
+    unsigned char key[TOKEN_INDEX_KEY_BYTES];
+    unsigned char state;
+} Slot;
+
+struct TokenIndex {
+    Slot *slots;
+    size_t capacity;  // power of two
+    size_t count;
+
+    char *tokens_path;
+    off_t tokens_offset;  // how much of tokens.txt has been loaded
+    int spent_fd;
+    off_t spent_offset;  // how much of the spent log has been replayed
+};
+
+// keys are SHA-256 outputs, so their leading bytes are already uniformly distributed
+static size_t key_hash(const unsigned char *key) {
+    size_t h;
+    memcpy(&h, key, sizeof(h));
+    return h;
+}
+
+static Slot *find_slot(Slot *slots, size_t capacity, const unsigned char *key) {
+    size_t mask = capacity - 1;
+    size_t i = key_hash(key) & mask;
+    while (slots[i].state != SLOT_EMPTY && memcmp(slots[i].key, key, TOKEN_INDEX_KEY_BYTES) != 0) {
+        i = (i + 1) & mask;
+    }
+    return &slots[i];
+}
+
+static int grow(TokenIndex *idx) {
+    size_t new_capacity = idx->capacity * 2;
+    Slot *slots = calloc(new_capacity, sizeof(Slot));
+    if (!slots) return 0;
+
+    for (size_t i = 0; i < idx->capacity; i++) {
+        if (idx->slots[i].state != SLOT_EMPTY) {
+            *find_slot(slots, new_capacity, idx->slots[i].key) = idx->slots[i];
+        }
+    }
+
+    free(idx->slots);
+    idx->slots = slots;
+    idx->capacity = new_capacity;
+    return 1;
+}
+
+static int insert_key(TokenIndex *idx, const unsigned char *key, unsigned char state) {
+    // keep the load factor under 1/2 so probe sequences stay short
+    if ((idx->count + 1) * 2 > idx->capacity && !grow(idx)) return 0;
+
+    Slot *slot = find_slot(idx->slots, idx->capacity, key);
+    if (slot->state == SLOT_EMPTY) {
+        memcpy(slot->key, key, TOKEN_INDEX_KEY_BYTES);
+        idx->count++;
+        slot->state = state;
+    } else if (state == SLOT_SPENT) {
+        slot->state = SLOT_SPENT;
+    }
+    return 1;
+}
+
+static int hex_val(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return 10 + (c - 'a');
+    if (c >= 'A' && c <= 'F') return 10 + (c - 'A');
+    return -1;
+}
+
+static int parse_key_hex(const char *hex, size_t len, unsigned char *key) {
+    if (len != TOKEN_INDEX_KEY_BYTES * 2) return 0;
+    for (size_t i = 0; i < TOKEN_INDEX_KEY_BYTES; i++) {
+        int hi = hex_val(hex[2 * i]);
+        int lo = hex_val(hex[2 * i + 1]);
+        if (hi < 0 || lo < 0) return 0;
+        key[i] = (unsigned char)((hi << 4) | lo);
+    }
+    return 1;
+}
+
+// loads complete lines appended to tokens.txt since the last call
+static int load_new_tokens(TokenIndex *idx) {
+    FILE *f = fopen(idx->tokens_path, "r");
+    if (!f) return errno == ENOENT;
+
+    if (fseeko(f, idx->tokens_offset, SEEK_SET) != 0) {
+        fclose(f);
+        return 0;
+    }
+
+    char line[512];
+    unsigned char key[TOKEN_INDEX_KEY_BYTES];
+    int ok = 1;
+    while (fgets(line, sizeof(line), f)) {
+        size_t len = strlen(line);
+        if (len == 0 || line[len - 1] != '\n') break;  // partial line still being written
+
+        idx->tokens_offset += (off_t)len;
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) len--;
+        if (len == 0) continue;
+
+        if (!parse_key_hex(line, len, key)) {
+            fprintf(stderr, "Skipping malformed token line in %s\n", idx->tokens_path);
+            continue;
+        }
+        if (!insert_key(idx, key, SLOT_LIVE)) {
+            ok = 0;
+            break;
+        }
+    }
+
+    fclose(f);
+    return ok;
+}
+
+// replays spent records appended since the last call; the caller holds a lock on
+// the log. a torn final record can only be a crash remnant since appends happen
+// under LOCK_EX, and it is cut off when the caller holds the exclusive lock
+static int replay_spent_log(TokenIndex *idx, int exclusive) {
+    unsigned char key[TOKEN_INDEX_KEY_BYTES];
+    while (1) {
+        ssize_t n = pread(idx->spent_fd, key, sizeof(key), idx->spent_offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        if (n == 0) break;
+        if (n < (ssize_t)sizeof(key)) {
+            // drop it so later appends stay aligned
+            return !exclusive || ftruncate(idx->spent_fd, idx->spent_offset) == 0;
+        }
+        if (!insert_key(idx, key, SLOT_SPENT)) return 0;
+        idx->spent_offset += n;
+    }
+    return 1;
+}
+
+TokenIndex *token_index_load(const char *tokens_path, const char *spent_log_path) {
+    TokenIndex *idx = calloc(1, sizeof(*idx));
+    if (!idx) return NULL;
+
+    idx->spent_fd = -1;
+    idx->capacity = TOKEN_INDEX_MIN_CAPACITY;
+    idx->slots = calloc(idx->capacity, sizeof(Slot));
+    idx->tokens_path = strdup(tokens_path);
+    if (!idx->slots || !idx->tokens_path) goto fail;
+
+    if (!load_new_tokens(idx)) {
+        fprintf(stderr, "Failed to load %s\n", tokens_path);
+        goto fail;
+    }
+
+    idx->spent_fd = open(spent_log_path, O_RDWR | O_CREAT | O_APPEND, 0600);
+    if (idx->spent_fd < 0) {
+        perror("open spent log");
+        goto fail;
+    }
+    flock(idx->spent_fd, LOCK_EX);
+    int replayed = replay_spent_log(idx, 1);
+    flock(idx->spent_fd, LOCK_UN);
+    if (!replayed) {
+        fprintf(stderr, "Failed to replay %s\n", spent_log_path);
+        goto fail;
+    }
+
+    return idx;
+
+fail:
+    token_index_free(idx);
+    return NULL;
+}
+
+void token_index_free(TokenIndex *idx) {
+    if (!idx) return;
+    if (idx->spent_fd >= 0) close(idx->spent_fd);
+    free(idx->slots);
+    free(idx->tokens_path);
+    free(idx);
+}
+
+int token_index_contains(TokenIndex *idx, const unsigned char key[TOKEN_INDEX_KEY_BYTES]) {
+    Slot *slot = find_slot(idx->slots, idx->capacity, key);
+    if (slot->state == SLOT_EMPTY) {
+        // registration may still be appending, pick up anything new before rejecting
+        if (!load_new_tokens(idx)) return 0;
+        slot = find_slot(idx->slots, idx->capacity, key);
+    }
+    return slot->state == SLOT_LIVE;
+}
+
+int token_index_sync_spent(TokenIndex *idx) {
+    if (flock(idx->spent_fd, LOCK_SH) != 0) return 0;
+    int ok = replay_spent_log(idx, 0);
+    flock(idx->spent_fd, LOCK_UN);
+    return ok;
+}
+
+int token_index_spend(TokenIndex *idx, const unsigned char key[TOKEN_INDEX_KEY_BYTES]) {
+    Slot *slot = find_slot(idx->slots, idx->capacity, key);
+    if (slot->state == SLOT_EMPTY) {
+        // a token published through the shared table may not have been loaded yet
+        if (!load_new_tokens(idx)) return -1;
+        slot = find_slot(idx->slots, idx->capacity, key);
+    }
+    if (slot->state != SLOT_LIVE) return 0;
+
+    // other voting processes share the log, so catch up on their spends and
+    // append while holding the lock to make check-and-spend atomic across them
+    if (flock(idx->spent_fd, LOCK_EX) != 0) {
+        perror("flock spent log");
+        return -1;
+    }
+
+    int rc = -1;
+    if (!replay_spent_log(idx, 1)) goto done;
+
+    slot = find_slot(idx->slots, idx->capacity, key);
+    if (slot->state != SLOT_LIVE) {
+        rc = 0;
+        goto done;
+    }
+
+    ssize_t n;
+    do {
+        n = write(idx->spent_fd, key, TOKEN_INDEX_KEY_BYTES);
+    } while (n < 0 && errno == EINTR);
+    if (n != TOKEN_INDEX_KEY_BYTES) {
+        perror("write spent log");
+        goto done;
+    }
+
+    idx->spent_offset += n;
+    slot->state = SLOT_SPENT;
+
+    // the ballot for this spend is made durable next, so the spend has to be durable
+    // first or a crash in between would let the token vote again after a restart
+    if (fdatasync(idx->spent_fd) != 0) {
+        perror("fdatasync spent log");
+        goto done;
+    }
+    rc = 1;
+
+done:
+    flock(idx->spent_fd, LOCK_UN);
+    return rc;
+}
+
+int token_index_is_spent(const TokenIndex *idx, const unsigned char key[TOKEN_INDEX_KEY_BYTES]) {
+    return find_slot(idx->slots, idx->capacity, key)->state == SLOT_SPENT;
+}
+
+size_t token_index_size(const TokenIndex *idx) {
+    return idx->count;
+}
@@ -0,0 +1,28 @@
+#ifndef TOKEN_INDEX_H
+#define TOKEN_INDEX_H
+
+#include <stddef.h>
+
+#define TOKEN_INDEX_KEY_BYTES 32
+
+// registered tokens keyed by the raw SHA-256 token hash, with spends recorded
+// in an append-only log that is replayed when the index is loaded
+typedef struct TokenIndex TokenIndex;
+
+TokenIndex *token_index_load(const char *tokens_path, const char *spent_log_path);
+void token_index_free(TokenIndex *idx);
+
+// 1 if the token is registered and not yet spent
+int token_index_contains(TokenIndex *idx, const unsigned char key[TOKEN_INDEX_KEY_BYTES]);
+// marks the token spent and appends it to the spent log, synced before it returns
+// 1. 1 on success, 0 if it is
+// not registered or already spent (also by another process sharing the log), -1 on I/O error
+int token_index_spend(TokenIndex *idx, const unsigned char key[TOKEN_INDEX_KEY_BYTES]);
+// 1 once a spend of the token has been seen, by this process or replayed from the log
+int token_index_is_spent(const TokenIndex *idx, const unsigned char key[TOKEN_INDEX_KEY_BYTES]);
+// picks up spends other processes appended to the log since the last sync
+int token_index_sync_spent(TokenIndex *idx);
+
+size_t token_index_size(const TokenIndex *idx);
+
+#endif
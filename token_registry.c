@@ -0,0 +1,182 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "token_registry.h"
+
+#define SLAB_KEYS 4096  // keys per arena slab
+#define MIN_CAPACITY 1024
+#define REF_EMPTY 0u
+#define REF_TOMBSTONE UINT32_MAX
+#define MAX_KEYS (UINT32_MAX - 1u)
+
+typedef struct {
+    uint32_t ref;  // arena index + 1, or REF_EMPTY / REF_TOMBSTONE
+    uint32_t tag;  // low hash bits, compared before touching the arena
+} Slot;
+
+struct TokenRegistry {
+    Slot *slots;
+    size_t capacity;  // power of two
+    size_t count;
+    size_t tombstones;
+
+    unsigned char **slabs;
+    size_t slab_count, slab_cap;
+    uint32_t arena_used;  // keys handed out from the slabs so far
+    uint32_t free_head;   // removed arena entries, chained through their first bytes
+};
+
+static uint64_t key_hash(const unsigned char *key) {
+    // keys are SHA-256 outputs, so their leading bytes are already uniformly distributed
+    uint64_t h;
+    memcpy(&h, key, sizeof(h));
+    return h;
+}
+
+static unsigned char *arena_key(const TokenRegistry *reg, uint32_t ref) {
+    uint32_t i = ref - 1;
+    return reg->slabs[i / SLAB_KEYS] + (size_t)(i % SLAB_KEYS) * TOKEN_REGISTRY_KEY_BYTES;
+}
+
+// returns a reference to a free arena entry, 0 on allocation failure
+static uint32_t arena_alloc(TokenRegistry *reg) {
+    if (reg->free_head != REF_EMPTY) {
+        uint32_t ref = reg->free_head;
+        memcpy(&reg->free_head, arena_key(reg, ref), sizeof(reg->free_head));
+        return ref;
+    }
+
+    if (reg->arena_used == MAX_KEYS) return 0;
+    if (reg->arena_used / SLAB_KEYS == reg->slab_count) {
+        if (reg->slab_count == reg->slab_cap) {
+            size_t cap = reg->slab_cap ? reg->slab_cap * 2 : 16;
+            unsigned char **slabs = realloc(reg->slabs, cap * sizeof(*slabs));
+            if (!slabs) return 0;
+            reg->slabs = slabs;
+            reg->slab_cap = cap;
+        }
+        unsigned char *slab = malloc((size_t)SLAB_KEYS * TOKEN_REGISTRY_KEY_BYTES);
+        if (!slab) return 0;
+        reg->slabs[reg->slab_count++] = slab;
+    }
+    return ++reg->arena_used;
+}
+
+static void arena_release(TokenRegistry *reg, uint32_t ref) {
+    memcpy(arena_key(reg, ref), &reg->free_head, sizeof(reg->free_head));
+    reg->free_head = ref;
+}
+
+// finds the slot holding key, or the slot an insert should use if it is absent
+static Slot *find_slot(const TokenRegistry *reg, Slot *slots, size_t capacity,
+                       const unsigned char *key, int *found) {
+    size_t mask = capacity - 1;
+    uint64_t h = key_hash(key);
+    uint32_t tag = (uint32_t)(h >> 32);
+    Slot *first_free = NULL;
+
+    for (size_t i = (size_t)h & mask;; i = (i + 1) & mask) {
+        Slot *slot = &slots[i];
+        if (slot->ref == REF_EMPTY) {
+            *found = 0;
+            return first_free ? first_free : slot;
+        }
+        if (slot->ref == REF_TOMBSTONE) {
+            if (!first_free) first_free = slot;
+        } else if (slot->tag == tag && memcmp(arena_key(reg, slot->ref), key, TOKEN_REGISTRY_KEY_BYTES) == 0) {
+            *found = 1;
+            return slot;
+        }
+    }
+}
+
+// rebuilds into a table sized for the live keys, which also clears tombstones
+static int rehash(TokenRegistry *reg, size_t new_capacity) {
+    Slot *slots = calloc(new_capacity, sizeof(Slot));
+    if (!slots) return 0;
+
+    for (size_t i = 0; i < reg->capacity; i++) {
+        Slot *old = &reg->slots[i];
+        if (old->ref == REF_EMPTY || old->ref == REF_TOMBSTONE) continue;
+        int found;
+        *find_slot(reg, slots, new_capacity, arena_key(reg, old->ref), &found) = *old;
+    }
+
+    free(reg->slots);
+    reg->slots = slots;
+    reg->capacity = new_capacity;
+    reg->tombstones = 0;
+    return 1;
+}
+
+TokenRegistry *token_registry_create(size_t expected) {
+    TokenRegistry *reg = calloc(1, sizeof(*reg));
+    if (!reg) return NULL;
+
+    // doubling up to expected * 2 must not wrap the capacity to 0
+    if (expected > SIZE_MAX / 4) {
+        free(reg);
+        return NULL;
+    }
+    reg->capacity = MIN_CAPACITY;
+    while (reg->capacity < expected * 2) reg->capacity *= 2;
+    reg->slots = calloc(reg->capacity, sizeof(Slot));
+    if (!reg->slots) {
+        free(reg);
+        return NULL;
+    }
+    return reg;
+}
+
+void token_registry_free(TokenRegistry *reg) {
+    if (!reg) return;
+    for (size_t i = 0; i < reg->slab_count; i++) free(reg->slabs[i]);
+    free(reg->slabs);
+    free(reg->slots);
+    free(reg);
+}
+
+int token_registry_insert(TokenRegistry *reg, const unsigned char key[TOKEN_REGISTRY_KEY_BYTES]) {
+    // keep live keys plus tombstones under half the table so probes stay short
+    if ((reg->count + reg->tombstones + 1) * 2 > reg->capacity) {
+        size_t capacity = reg->capacity;
+        if ((reg->count + 1) * 2 > capacity / 2) capacity *= 2;
+        if (!rehash(reg, capacity)) return -1;
+    }
+
+    int found;
+    Slot *slot = find_slot(reg, reg->slots, reg->capacity, key, &found);
+    if (found) return 0;
+
+    uint32_t ref = arena_alloc(reg);
+    if (ref == 0) return -1;
+    memcpy(arena_key(reg, ref), key, TOKEN_REGISTRY_KEY_BYTES);
+
+    if (slot->ref == REF_TOMBSTONE) reg->tombstones--;
+    slot->ref = ref;
+    slot->tag = (uint32_t)(key_hash(key) >> 32);
+    reg->count++;
+    return 1;
+}
+
+int token_registry_contains(const TokenRegistry *reg, const unsigned char key[TOKEN_REGISTRY_KEY_BYTES]) {
+    int found;
+    find_slot(reg, reg->slots, reg->capacity, key, &found);
+    return found;
+}
+
+int token_registry_remove(TokenRegistry *reg, const unsigned char key[TOKEN_REGISTRY_KEY_BYTES]) {
+    int found;
+    Slot *slot = find_slot(reg, reg->slots, reg->capacity, key, &found);
+    if (!found) return 0;
+
+    arena_release(reg, slot->ref);
+    slot->ref = REF_TOMBSTONE;
+    reg->tombstones++;
+    reg->count--;
+    return 1;
+}
+
+size_t token_registry_count(const TokenRegistry *reg) {
+    return reg->count;
+}
@@ -0,0 +1,24 @@
+#ifndef TOKEN_REGISTRY_H
+#define TOKEN_REGISTRY_H
+
+#include <stddef.h>
+
+#define TOKEN_REGISTRY_KEY_BYTES 32
+
+// tokens issued by this registration run, keyed by the raw SHA-256 token hash.
+// keys live in a slab arena and the table only holds 32-bit references to them,
+// so inserts never malloc per entry and the table grows without bound
+typedef struct TokenRegistry TokenRegistry;
+
+TokenRegistry *token_registry_create(size_t expected);
+void token_registry_free(TokenRegistry *reg);
+
+// 1 if inserted, 0 if already present, -1 on allocation failure
+int token_registry_insert(TokenRegistry *reg, const unsigned char key[TOKEN_REGISTRY_KEY_BYTES]);
+int token_registry_contains(const TokenRegistry *reg, const unsigned char key[TOKEN_REGISTRY_KEY_BYTES]);
+// 1 if removed, 0 if it was not present
+int token_registry_remove(TokenRegistry *reg, const unsigned char key[TOKEN_REGISTRY_KEY_BYTES]);
+
+size_t token_registry_count(const TokenRegistry *reg);
+
+#endif
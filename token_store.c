@@ -0,0 +1,406 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "crc32.h"
+#include "token_store.h"
+
+#define TOKEN_STORE_MAGIC "EVTS"
+#define TOKEN_STORE_VERSION 1
+#define INTERPOLATION_PROBES 8
+
+// host byte order, the store is not meant to move between machines
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+    uint64_t bitmap_offset;
+    uint32_t records_crc;
+    uint32_t header_crc;  // over all fields above
+    unsigned char reserved[32];
+} TokenStoreHeader;
+
+struct TokenStore {
+    int fd;
+    size_t count;
+    const unsigned char *map;  // header followed by the sorted records
+    size_t map_len;
+    unsigned char *bitmap;
+    size_t bitmap_len;
+    long page_size;
+};
+
+static const unsigned char *record_at(const TokenStore *store, size_t i) {
+    return store->map + sizeof(TokenStoreHeader) + i * TOKEN_STORE_KEY_BYTES;
+}
+
+static size_t bitmap_bytes(uint64_t count) {
+    return (size_t)((count + 7) / 8);
+}
+
+static uint64_t records_end(uint64_t count) {
+    return sizeof(TokenStoreHeader) + count * TOKEN_STORE_KEY_BYTES;
+}
+
+static uint64_t bitmap_offset_for(uint64_t count, long page_size) {
+    uint64_t end = records_end(count);
+    return (end + (uint64_t)page_size - 1) / (uint64_t)page_size * (uint64_t)page_size;
+}
+
+static uint32_t header_crc(const TokenStoreHeader *h) {
+    return crc32_update(0, h, offsetof(TokenStoreHeader, header_crc));
+}
+
+static TokenStore *open_store(const char *path, int take_lock) {
+    TokenStore *store = calloc(1, sizeof(*store));
+    if (!store) return NULL;
+    store->fd = -1;
+    store->page_size = sysconf(_SC_PAGESIZE);
+
+    // shared lock for as long as the store is open, merge takes it exclusively.
+    // a merge may rename a new file over path between open and flock, leaving
+    // this lock on the unlinked old file, so reopen until path still names it
+    while (1) {
+        store->fd = open(path, O_RDWR);
+        if (store->fd < 0) goto fail;
+        if (!take_lock) break;
+        if (flock(store->fd, LOCK_SH) != 0) goto fail;
+
+        struct stat locked, named;
+        if (fstat(store->fd, &locked) != 0 || stat(path, &named) != 0) goto fail;
+        if (locked.st_dev == named.st_dev && locked.st_ino == named.st_ino) break;
+        close(store->fd);
+    }
+
+    TokenStoreHeader h;
+    if (pread(store->fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h)) goto corrupt;
+    if (memcmp(h.magic, TOKEN_STORE_MAGIC, 4) != 0 || h.version != TOKEN_STORE_VERSION) goto corrupt;
+    if (h.header_crc != header_crc(&h)) goto corrupt;
+    if (h.bitmap_offset != bitmap_offset_for(h.count, store->page_size)) goto corrupt;
+
+    struct stat st;
+    if (fstat(store->fd, &st) != 0) goto fail;
+    if ((uint64_t)st.st_size < h.bitmap_offset + bitmap_bytes(h.count)) goto corrupt;
+
+    store->count = (size_t)h.count;
+    store->map_len = (size_t)records_end(h.count);
+    store->map = mmap(NULL, store->map_len, PROT_READ, MAP_SHARED, store->fd, 0);
+    if (store->map == MAP_FAILED) {
+        store->map = NULL;
+        goto fail;
+    }
+    madvise((void *)store->map, store->map_len, MADV_RANDOM);
+
+    if (crc32_update(0, record_at(store, 0), store->count * TOKEN_STORE_KEY_BYTES) != h.records_crc) goto corrupt;
+
+    if (store->count > 0) {
+        store->bitmap_len = bitmap_bytes(h.count);
+        store->bitmap = mmap(NULL, store->bitmap_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+                             store->fd, (off_t)h.bitmap_offset);
+        if (store->bitmap == MAP_FAILED) {
+            store->bitmap = NULL;
+            goto fail;
+        }
+    }
+
+    return store;
+
+corrupt:
+    fprintf(stderr, "Token store %s is corrupt or has an unknown format\n", path);
+fail:
+    token_store_close(store);
+    return NULL;
+}
+
+TokenStore *token_store_open(const char *path) {
+    return open_store(path, 1);
+}
+
+void token_store_close(TokenStore *store) {
+    if (!store) return;
+    if (store->bitmap) munmap(store->bitmap, store->bitmap_len);
+    if (store->map) munmap((void *)store->map, store->map_len);
+    if (store->fd >= 0) close(store->fd);
+    free(store);
+}
+
+size_t token_store_count(const TokenStore *store) {
+    return store->count;
+}
+
+static uint64_t key_prefix(const unsigned char *key) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        v = (v << 8) | key[i];
+    }
+    return v;
+}
+
+// SHA-256 keys are uniform, so interpolating on the leading 8 bytes lands next to
+// the target in a couple of probes; binary search finishes off whatever is left
+long long token_store_find(const TokenStore *store, const unsigned char key[TOKEN_STORE_KEY_BYTES]) {
+    if (store->count == 0) return -1;
+
+    size_t lo = 0;
+    size_t hi = store->count - 1;
+    uint64_t target = key_prefix(key);
+
+    for (int probe = 0; probe < INTERPOLATION_PROBES && lo < hi; probe++) {
+        uint64_t lo_key = key_prefix(record_at(store, lo));
+        uint64_t hi_key = key_prefix(record_at(store, hi));
+        if (target < lo_key || target > hi_key || lo_key == hi_key) break;
+
+        size_t pos = lo + (size_t)((unsigned __int128)(target - lo_key) * (hi - lo) / (hi_key - lo_key));
+        int cmp = memcmp(key, record_at(store, pos), TOKEN_STORE_KEY_BYTES);
+        if (cmp == 0) return (long long)pos;
+        if (cmp < 0) {
+            if (pos == 0) return -1;
+            hi = pos - 1;
+        } else {
+            lo = pos + 1;
+        }
+    }
+
+    size_t left = lo;
+    size_t right = hi + 1;
+    while (left < right) {
+        size_t mid = left + (right - left) / 2;
+        int cmp = memcmp(key, record_at(store, mid), TOKEN_STORE_KEY_BYTES);
+        if (cmp == 0) return (long long)mid;
+        if (cmp < 0) {
+            right = mid;
+        } else {
+            left = mid + 1;
+        }
+    }
+    return -1;
+}
+
+int token_store_is_spent(const TokenStore *store, size_t index) {
+    if (index >= store->count) return 0;
+    unsigned char byte = __atomic_load_n(&store->bitmap[index / 8], __ATOMIC_ACQUIRE);
+    return (byte >> (index % 8)) & 1;
+}
+
+int token_store_spend(TokenStore *store, size_t index) {
+    if (index >= store->count) return -1;
+
+    unsigned char mask = (unsigned char)(1u << (index % 8));
+    unsigned char old = __atomic_fetch_or(&store->bitmap[index / 8], mask, __ATOMIC_ACQ_REL);
+    if (old & mask) return 0;
+
+    size_t page = (index / 8) & ~((size_t)store->page_size - 1);
+    size_t len = store->bitmap_len - page < (size_t)store->page_size ? store->bitmap_len - page : (size_t)store->page_size;
+    if (msync(store->bitmap + page, len, MS_SYNC) != 0) {
+        perror("msync token bitmap");
+        return -1;
+    }
+    return 1;
+}
+
+static int write_all(int fd, const void *buf, size_t len) {
+    const unsigned char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+static int compare_keys(const void *a, const void *b) {
+    return memcmp(a, b, TOKEN_STORE_KEY_BYTES);
+}
+
+// reads complete records from the stage, sorted and without duplicates
+static unsigned char *load_stage(const char *stage_path, size_t *count_out) {
+    *count_out = 0;
+    int fd = open(stage_path, O_RDONLY);
+    if (fd < 0) {
+        return errno == ENOENT ? calloc(1, TOKEN_STORE_KEY_BYTES) : NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t count = (size_t)st.st_size / TOKEN_STORE_KEY_BYTES;  // a torn final record is dropped
+    unsigned char *keys = malloc(count ? count * TOKEN_STORE_KEY_BYTES : TOKEN_STORE_KEY_BYTES);
+    if (!keys) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t want = count * TOKEN_STORE_KEY_BYTES;
+    size_t got = 0;
+    while (got < want) {
+        ssize_t n = read(fd, keys + got, want - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    close(fd);
+    if (got != want) {
+        free(keys);
+        return NULL;
+    }
+
+    qsort(keys, count, TOKEN_STORE_KEY_BYTES, compare_keys);
+
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (unique == 0 || memcmp(keys + i * TOKEN_STORE_KEY_BYTES, keys + (unique - 1) * TOKEN_STORE_KEY_BYTES, TOKEN_STORE_KEY_BYTES) != 0) {
+            memmove(keys + unique * TOKEN_STORE_KEY_BYTES, keys + i * TOKEN_STORE_KEY_BYTES, TOKEN_STORE_KEY_BYTES);
+            unique++;
+        }
+    }
+
+    *count_out = unique;
+    return keys;
+}
+
+static void fsync_parent_dir(const char *path) {
+    char *copy = strdup(path);
+    if (!copy) return;
+    int dfd = open(dirname(copy), O_RDONLY | O_DIRECTORY);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
+    free(copy);
+}
+
+typedef struct {
+    int fd;
+    unsigned char buf[64 * 1024];
+    size_t used;
+    uint32_t crc;
+} RecordWriter;
+
+static int writer_put(RecordWriter *w, const unsigned char *key) {
+    if (w->used + TOKEN_STORE_KEY_BYTES > sizeof(w->buf)) {
+        if (!write_all(w->fd, w->buf, w->used)) return 0;
+        w->used = 0;
+    }
+    memcpy(w->buf + w->used, key, TOKEN_STORE_KEY_BYTES);
+    w->used += TOKEN_STORE_KEY_BYTES;
+    w->crc = crc32_update(w->crc, key, TOKEN_STORE_KEY_BYTES);
+    return 1;
+}
+
+int token_store_merge(const char *path, const char *stage_path) {
+    int ok = 0;
+    int tmp_fd = -1;
+    int lock_fd = -1;
+    TokenStore *old = NULL;
+    unsigned char *bitmap = NULL;
+    RecordWriter *w = NULL;
+    char tmp_path[4096];
+
+    size_t staged = 0;
+    unsigned char *stage = load_stage(stage_path, &staged);
+    if (!stage) {
+        fprintf(stderr, "Failed to read token stage %s\n", stage_path);
+        return 0;
+    }
+    if (staged == 0 && access(path, F_OK) == 0) {
+        free(stage);
+        return 1;
+    }
+
+    lock_fd = open(path, O_RDWR);
+    if (lock_fd >= 0) {
+        if (flock(lock_fd, LOCK_EX | LOCK_NB) != 0) {
+            fprintf(stderr, "Token store %s is in use, keeping %zu staged tokens for a later merge\n", path, staged);
+            goto done;
+        }
+        old = open_store(path, 0);
+        if (!old) goto done;
+    }
+
+    size_t old_count = old ? old->count : 0;
+    size_t max_count = old_count + staged;
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    bitmap = calloc(1, bitmap_bytes(max_count) + 1);
+    w = calloc(1, sizeof(*w));
+    if (!bitmap || !w) goto done;
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    tmp_fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (tmp_fd < 0) {
+        perror("open token store");
+        goto done;
+    }
+    w->fd = tmp_fd;
+    if (lseek(tmp_fd, sizeof(TokenStoreHeader), SEEK_SET) < 0) goto done;
+
+    // two-way merge of the old records and the sorted stage, carrying spent bits over
+    size_t i = 0, j = 0, count = 0;
+    while (i < old_count || j < staged) {
+        const unsigned char *a = i < old_count ? record_at(old, i) : NULL;
+        const unsigned char *b = j < staged ? stage + j * TOKEN_STORE_KEY_BYTES : NULL;
+        int cmp = !a ? 1 : !b ? -1 : memcmp(a, b, TOKEN_STORE_KEY_BYTES);
+
+        const unsigned char *key = cmp <= 0 ? a : b;
+        int spent = cmp <= 0 && token_store_is_spent(old, i);
+        if (cmp <= 0) i++;
+        if (cmp >= 0) j++;
+
+        if (!writer_put(w, key)) goto done;
+        if (spent) bitmap[count / 8] |= (unsigned char)(1u << (count % 8));
+        count++;
+    }
+    if (w->used > 0 && !write_all(tmp_fd, w->buf, w->used)) goto done;
+
+    TokenStoreHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, TOKEN_STORE_MAGIC, 4);
+    h.version = TOKEN_STORE_VERSION;
+    h.count = count;
+    h.bitmap_offset = bitmap_offset_for(count, page_size);
+    h.records_crc = w->crc;
+    h.header_crc = header_crc(&h);
+
+    if (pwrite(tmp_fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h)) goto done;
+    if (ftruncate(tmp_fd, (off_t)(h.bitmap_offset + bitmap_bytes(count))) != 0) goto done;
+    if (count > 0 && pwrite(tmp_fd, bitmap, bitmap_bytes(count), (off_t)h.bitmap_offset) != (ssize_t)bitmap_bytes(count)) goto done;
+    if (fsync(tmp_fd) != 0) goto done;
+
+    if (rename(tmp_path, path) != 0) {
+        perror("rename token store");
+        goto done;
+    }
+    fsync_parent_dir(path);
+
+    if (truncate(stage_path, 0) != 0 && errno != ENOENT) {
+        perror("truncate token stage");
+        goto done;
+    }
+    ok = 1;
+
+done:
+    if (tmp_fd >= 0) {
+        close(tmp_fd);
+        if (!ok) unlink(tmp_path);
+    }
+    token_store_close(old);
+    if (lock_fd >= 0) close(lock_fd);
+    free(w);
+    free(bitmap);
+    free(stage);
+    return ok;
+}
@@ -0,0 +1,28 @@
+#ifndef TOKEN_STORE_H
+#define TOKEN_STORE_H
+
+#include <stddef.h>
+
+#define TOKEN_STORE_KEY_BYTES 32
+
+// binary token store: a header with a CRC, sorted 32-byte token hashes mapped
+// read-only, and a spent bitmap in the same file mapped shared so a spend is a
+// single bit flip. new tokens go to a staging segment that is merged in later.
+typedef struct TokenStore TokenStore;
+
+TokenStore *token_store_open(const char *path);
+void token_store_close(TokenStore *store);
+size_t token_store_count(const TokenStore *store);
+
+// returns the record index of key, or -1 if it is not in the store
+long long token_store_find(const TokenStore *store, const unsigned char key[TOKEN_STORE_KEY_BYTES]);
+int token_store_is_spent(const TokenStore *store, size_t index);
+// 1 if this call marked the token spent, 0 if it was already spent, -1 on error
+int token_store_spend(TokenStore *store, size_t index);
+
+// folds the staging segment (raw 32-byte hashes written by a token appender) into
+// the store and empties it. called by the writer once it has stopped appending;
+// keeps the stage if a reader still has the store open.
+int token_store_merge(const char *path, const char *stage_path);
+
+#endif
@@ -1,16 +1,40 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <time.h>
+#include <unistd.h>
 #include <openssl/bn.h>
 #include <openssl/sha.h>
 #include <openssl/rand.h>
 #include "rsa.h"
 #include "paillier.h"
+#include "rsa_verify.h"
+#include "token_index.h"
+#include "token_store.h"
+#include "ballot_log.h"
+#include "spent_filter.h"
+#include "shm_token_table.h"
+#include "tally_checkpoint.h"
+#include "bulletin_board.h"
+#include "ballot_archive.h"
 
 #define NONCE_BYTES 16
-#define MAX_VOTERS 38
 #define VOTING_DURATION_SECONDS (2 * 60)
+#define TOKENS_FILE "tokens.txt"
+#define SPENT_LOG_FILE "tokens.spent"
+#define TOKEN_STORE_FILE "tokens.bin"
+#define SPENT_FILTER_DIR "spent.d"
+#define SPENT_FILTER_SYNC_MS 200
+#define BALLOT_LOG_FILE "ballots.wal"
+#define BALLOT_LOG_BATCH_RECORDS 32
+#define BALLOT_LOG_BATCH_MS 50
+#define PAILLIER_KEY_FILE "paillier.key"
+#define TALLY_CHECKPOINT_FILE "tally.ckpt"
+#define TALLY_CHECKPOINT_BALLOTS 16
+#define TALLY_CHECKPOINT_SECONDS 30
+#define BOARD_FILE "board.bin"
+#define BOARD_ROOTS_FILE "board.roots"
 
 static int hexchar_to_val(char c) {
     if (c >= '0' && c <= '9') return c - '0';
@@ -61,144 +85,422 @@ static BIGNUM *token_hash_to_bn(const unsigned char token_hash[SHA256_DIGEST_LEN
     return m;
 }
 
-static int verify_signature(const BIGNUM *m, const BIGNUM *s,
-                            const BIGNUM *N, const BIGNUM *e, BN_CTX *ctx) {
-    int res = 0;
-    BIGNUM *m_check = BN_new();
-    if (!m_check) return 0;
+// registered tokens come from the binary store when registration produced one,
+// otherwise from the tokens.txt index. the store's spent bitmap is shared memory,
+// but index spends made by other voting processes are only on disk, so the index
+// path consults a spent filter fed by their snapshots before trusting memory.
+// a shared-memory table published by a running registration for the same key
+// takes precedence over both; the on-disk source still records its spends so
+// they survive the table, through the spent log for tokens the store lacks
+typedef struct {
+    ShmTokenTable *shared;
+    TokenStore *store;
+    TokenIndex *index;
+    SpentFilter *filter;
+} TokenSource;
+
+// tokens spent while only the shared table had them are in the spent log; once
+// the stage is merged they are in the store too, so mark them spent there
+static int apply_spent_log(TokenStore *store) {
+    FILE *f = fopen(SPENT_LOG_FILE, "rb");
+    if (!f) return errno == ENOENT;
+
+    int ok = 1;
+    unsigned char key[TOKEN_STORE_KEY_BYTES];
+    while (ok && fread(key, 1, sizeof(key), f) == sizeof(key)) {
+        long long idx = token_store_find(store, key);
+        if (idx >= 0 && token_store_spend(store, (size_t)idx) < 0) ok = 0;
+    }
+    if (ferror(f)) ok = 0;
+    fclose(f);
+    return ok;
+}
 
-    if (!BN_mod_exp(m_check, s, e, N, ctx)) {
-        BN_free(m_check);
-        return 0;
+static int token_source_open(TokenSource *src, const BIGNUM *N) {
+    unsigned char fingerprint[SHM_TOKEN_FINGERPRINT_BYTES];
+    if (shm_token_table_fingerprint(N, fingerprint)) {
+        src->shared = shm_token_table_attach(SHM_TOKEN_TABLE_NAME, fingerprint);
+    }
+    if (src->shared) {
+        printf("Attached to shared token table (%zu tokens so far)\n", shm_token_table_count(src->shared));
     }
 
-    res = (BN_cmp(m_check, m) == 0);
-    BN_free(m_check);
-    return res;
+    if (access(TOKEN_STORE_FILE, F_OK) == 0) {
+        src->store = token_store_open(TOKEN_STORE_FILE);
+        if (!src->store) return 0;
+        printf("Loaded %zu registered tokens from %s\n", token_store_count(src->store), TOKEN_STORE_FILE);
+        if (!apply_spent_log(src->store)) {
+            fprintf(stderr, "Failed to carry %s into %s\n", SPENT_LOG_FILE, TOKEN_STORE_FILE);
+            return 0;
+        }
+        return 1;
+    }
+
+    src->index = token_index_load(TOKENS_FILE, SPENT_LOG_FILE);
+    if (!src->index) return 0;
+    printf("Loaded %zu registered tokens from %s\n", token_index_size(src->index), TOKENS_FILE);
+
+    src->filter = spent_filter_create(token_index_size(src->index), SPENT_FILTER_DIR, SPENT_FILTER_SYNC_MS);
+    if (!src->filter) {
+        fprintf(stderr, "Warning: no spent filter, spends by other voting processes are caught only at spend time\n");
+    }
+    return 1;
 }
 
-static void trim_newline(char *s) {
-    size_t len = strlen(s);
-    while (len > 0 && (s[len - 1] == '\n' || s[len - 1] == '\r')) {
-        s[--len] = '\0';
+static void token_source_close(TokenSource *src) {
+    shm_token_table_detach(src->shared);
+    token_store_close(src->store);
+    spent_filter_free(src->filter);
+    token_index_free(src->index);
+}
+
+static int token_available(TokenSource *src, const unsigned char token_hash[SHA256_DIGEST_LENGTH]) {
+    if (src->shared) {
+        int state = shm_token_table_lookup(src->shared, token_hash);
+        if (state != SHM_TOKEN_ABSENT) return state == SHM_TOKEN_LIVE;
+    }
+    if (src->store) {
+        long long idx = token_store_find(src->store, token_hash);
+        return idx >= 0 && !token_store_is_spent(src->store, (size_t)idx);
     }
+    if (!token_index_contains(src->index, token_hash)) return 0;
+
+    // fresh tokens miss the filter and never leave memory; a hit may be a spend
+    // by another process or a false positive, so confirm it against the log
+    if (src->filter && spent_filter_maybe_contains(src->filter, token_hash)) {
+        if (!token_index_sync_spent(src->index)) return 0;
+        return token_index_contains(src->index, token_hash);
+    }
+    return 1;
 }
 
-static int token_exists(const char *token_hex) {
-    FILE *f = fopen("tokens.txt", "r");
-    if (!f) return 0;
+typedef struct {
+    u64 n_squared;
+    u64 c_tally;
+    unsigned long long valid_votes;
+    uint64_t last_seq;
+} TallyReplay;
+
+static int replay_ballot(const BallotRecord *rec, void *arg) {
+    TallyReplay *t = arg;
+    t->c_tally = mod_mul(t->c_tally, rec->ciphertext, t->n_squared);
+    t->valid_votes++;
+    t->last_seq = rec->seq;
+    return 1;
+}
 
-    char line[512];
-    int found = 0;
+// the checkpoint may only name ballots that are already durable in the log
+static int write_tally_checkpoint(BallotLog *ballots, u64 key_id, u64 c_tally,
+                                  unsigned long long valid_votes, uint64_t last_seq) {
+    if (!ballot_log_wait_durable(ballots, last_seq)) return 0;
+    TallyCheckpoint cp = { key_id, c_tally, valid_votes, last_seq };
+    return tally_checkpoint_write(TALLY_CHECKPOINT_FILE, &cp);
+}
 
-    while (fgets(line, sizeof(line), f)) {
-        trim_newline(line);
-        if (line[0] == '\0') continue;
-        if (strcmp(line, token_hex) == 0) {
-            found = 1;
-            break;
+// 1 if the token is now spent by this voter, 0 if someone spent it first, -1 on I/O error
+static int token_spend_on_disk(TokenSource *src, const unsigned char token_hash[SHA256_DIGEST_LENGTH]) {
+    if (src->store) {
+        long long idx = token_store_find(src->store, token_hash);
+        if (idx >= 0) return token_store_spend(src->store, (size_t)idx);
+
+        // issued after tokens.bin was merged, so only the shared table has it. the
+        // table does not survive a reboot or a new registration run, so the spend
+        // goes to the synced spent log, which the next start carries into the store
+        if (!src->index) src->index = token_index_load(TOKENS_FILE, SPENT_LOG_FILE);
+        if (!src->index) return -1;
+        int rc = token_index_spend(src->index, token_hash);
+        // not in tokens.txt yet either (a batch still buffered), so nothing durable can record it
+        if (rc == 0 && !token_index_is_spent(src->index, token_hash)) return -1;
+        return rc;
+    }
+    int rc = token_index_spend(src->index, token_hash);
+    if (rc == 1 && src->filter) spent_filter_add(src->filter, token_hash);
+    return rc;
+}
+
+// a token only published through the shared table is not on disk yet, so it is
+// not spent there unless the spent log has it
+static int token_spent_on_disk(TokenSource *src, const unsigned char token_hash[SHA256_DIGEST_LENGTH]) {
+    if (src->store) {
+        long long idx = token_store_find(src->store, token_hash);
+        if (idx >= 0) return token_store_is_spent(src->store, (size_t)idx);
+    }
+    return src->index && token_index_is_spent(src->index, token_hash);
+}
+
+static int token_spend(TokenSource *src, const unsigned char token_hash[SHA256_DIGEST_LENGTH]) {
+    if (src->shared) {
+        int rc = shm_token_table_spend(src->shared, token_hash);
+        if (rc == 0) return 0;
+        if (rc == 1) {
+            // the table decided the race between processes attached to it, but one
+            // running without the table spends on disk only, so the disk must agree
+            if (src->store || src->index) {
+                int on_disk = token_spend_on_disk(src, token_hash);
+                if (on_disk == 0 && token_spent_on_disk(src, token_hash)) return 0;
+                // the table slot stays spent, but a spend that would not survive
+                // the table must not count
+                if (on_disk < 0) return -1;
+            }
+            return 1;
         }
     }
+    return token_spend_on_disk(src, token_hash);
+}
 
-    fclose(f);
-    return found;
+// streams every archived ballot to stdout, multiplying the ciphertexts back into a
+// tally; the archive is what gets published, so its tally and count are the result
+static int publish_ballots(const Paillier_pub_key *pub, u64 *tally_out, unsigned long long *count_out) {
+    BallotArchive *archive = ballot_archive_open(BALLOT_LOG_FILE);
+    if (!archive) return 0;
+
+    printf("\n=== Published encrypted votes (ciphertexts) ===\n");
+    u64 tally = 1 % pub->n_squared;
+    const BallotRecord *records;
+    long n;
+    while ((n = ballot_archive_next(archive, &records)) > 0) {
+        for (long i = 0; i < n; i++) {
+            printf("Voter %llu: c = %llu\n",
+                   (unsigned long long)records[i].seq,
+                   (unsigned long long)records[i].ciphertext);
+            tally = mod_mul(tally, records[i].ciphertext, pub->n_squared);
+        }
+    }
+    uint64_t archived = ballot_archive_count(archive);
+    ballot_archive_close(archive);
+    if (n < 0) return 0;
+
+    *tally_out = tally;
+    *count_out = (unsigned long long)archived;
+    return 1;
 }
 
-static int remove_token(const char *token_hex) {
-    FILE *fin = fopen("tokens.txt", "r");
-    if (!fin) return 0;
+static void print_hex(const unsigned char *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) printf("%02x", buf[i]);
+}
 
-    FILE *fout = fopen("tokens.tmp", "w");
-    if (!fout) {
-        fclose(fin);
+// brings the board up to the ballot log after a crash between the two appends
+static int board_catch_up_one(const BallotRecord *rec, void *arg) {
+    BoardEntry entry = { rec->seq, {0}, rec->ciphertext };
+    memcpy(entry.token_hash, rec->token_hash, BOARD_TOKEN_BYTES);
+    return board_writer_append(arg, &entry);
+}
+
+// appends "<size> <root hex>" so observers can ask for consistency between any two published roots
+static int publish_board_root(BoardWriter *board) {
+    unsigned char root[BOARD_HASH_BYTES];
+    board_writer_root(board, root);
+
+    FILE *f = fopen(BOARD_ROOTS_FILE, "a");
+    if (!f) {
+        perror("fopen board roots");
         return 0;
     }
+    fprintf(f, "%llu ", (unsigned long long)board_writer_size(board));
+    for (int i = 0; i < BOARD_HASH_BYTES; i++) fprintf(f, "%02x", root[i]);
+    fputc('\n', f);
+    int ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+    if (fclose(f) != 0) ok = 0;
+
+    printf("\n=== Bulletin board ===\n");
+    printf("%llu ballots in %s, root ", (unsigned long long)board_writer_size(board), BOARD_FILE);
+    print_hex(root, BOARD_HASH_BYTES);
+    printf("\nCheck a ballot with --board-proof <token_hash_hex>.\n");
+    return ok;
+}
 
-    char line[512];
-    int removed = 0;
+static void print_proof(unsigned char path[][BOARD_HASH_BYTES], int len) {
+    for (int i = 0; i < len; i++) {
+        printf("  ");
+        print_hex(path[i], BOARD_HASH_BYTES);
+        printf("\n");
+    }
+}
 
-    while (fgets(line, sizeof(line), fin)) {
-        trim_newline(line);
-        if (line[0] == '\0') continue;
-        if (!removed && strcmp(line, token_hex) == 0) {
-            removed = 1;
-            continue;
-        }
-        fprintf(fout, "%s\n", line);
+static int run_board_proof(const char *token_hex) {
+    unsigned char token_hash[BOARD_TOKEN_BYTES];
+    if (!parse_fixed_hex(token_hex, token_hash, BOARD_TOKEN_BYTES)) {
+        fprintf(stderr, "Invalid token hash hex length/format\n");
+        return 1;
     }
 
-    fclose(fin);
-    fclose(fout);
+    BoardTree *t = board_tree_load(BOARD_FILE);
+    if (!t) return 1;
 
-    if (!removed) {
-        remove("tokens.tmp");
-        return 0;
+    int rc = 1;
+    long long index = board_tree_find(t, token_hash);
+    if (index < 0) {
+        fprintf(stderr, "No ballot with that token hash on the board\n");
+        goto done;
     }
 
-    if (remove("tokens.txt") != 0) {
-        return 0;
+    BoardEntry entry;
+    unsigned char leaf[BOARD_HASH_BYTES], root[BOARD_HASH_BYTES];
+    unsigned char path[BOARD_MAX_PROOF][BOARD_HASH_BYTES];
+    uint64_t size = board_tree_size(t);
+    board_tree_entry(t, (uint64_t)index, &entry);
+    board_leaf_hash(&entry, leaf);
+    board_tree_root(t, size, root);
+    int len = board_tree_inclusion_proof(t, (uint64_t)index, size, path);
+
+    printf("Ballot %lld of %llu, c = %llu\n", index, (unsigned long long)size, (unsigned long long)entry.ciphertext);
+    printf("Leaf hash: ");
+    print_hex(leaf, BOARD_HASH_BYTES);
+    printf("\nRoot:      ");
+    print_hex(root, BOARD_HASH_BYTES);
+    printf("\nInclusion proof (%d hashes):\n", len);
+    print_proof(path, len);
+
+    if (!board_verify_inclusion(leaf, (uint64_t)index, size, path, len, root)) {
+        fprintf(stderr, "Inclusion proof does not verify\n");
+        goto done;
     }
-    if (rename("tokens.tmp", "tokens.txt") != 0) {
-        return 0;
+    printf("Proof verified against the root.\n");
+    rc = 0;
+
+done:
+    board_tree_free(t);
+    return rc;
+}
+
+static int run_board_consistency(const char *old_str, const char *new_str) {
+    char *end_old = NULL, *end_new = NULL;
+    unsigned long long old_size = strtoull(old_str, &end_old, 10);
+    unsigned long long new_size = strtoull(new_str, &end_new, 10);
+    if (*end_old != '\0' || *end_new != '\0' || old_size > new_size) {
+        fprintf(stderr, "Expected two tree sizes, old <= new\n");
+        return 1;
     }
 
-    return 1;
+    BoardTree *t = board_tree_load(BOARD_FILE);
+    if (!t) return 1;
+
+    int rc = 1;
+    unsigned char old_root[BOARD_HASH_BYTES], new_root[BOARD_HASH_BYTES];
+    unsigned char path[BOARD_MAX_PROOF][BOARD_HASH_BYTES];
+    if (!board_tree_root(t, old_size, old_root) || !board_tree_root(t, new_size, new_root)) {
+        fprintf(stderr, "The board only has %llu ballots\n", (unsigned long long)board_tree_size(t));
+        goto done;
+    }
+    int len = board_tree_consistency_proof(t, old_size, new_size, path);
+
+    printf("Root at %llu: ", old_size);
+    print_hex(old_root, BOARD_HASH_BYTES);
+    printf("\nRoot at %llu: ", new_size);
+    print_hex(new_root, BOARD_HASH_BYTES);
+    printf("\nConsistency proof (%d hashes):\n", len);
+    print_proof(path, len);
+
+    if (!board_verify_consistency(old_size, new_size, old_root, new_root, path, len)) {
+        fprintf(stderr, "Consistency proof does not verify\n");
+        goto done;
+    }
+    printf("Proof verified: the newer board extends the older one.\n");
+    rc = 0;
+
+done:
+    board_tree_free(t);
+    return rc;
 }
 
 int main(int argc, char *argv[]) {
+    if (argc == 3 && strcmp(argv[1], "--board-proof") == 0) {
+        return run_board_proof(argv[2]);
+    }
+    if (argc == 4 && strcmp(argv[1], "--board-consistency") == 0) {
+        return run_board_consistency(argv[2], argv[3]);
+    }
     if (argc != 3) {
         fprintf(stderr,
                 "Usage: %s <N_hex> <e_hex>\n"
-                "  N_hex, e_hex: RSA public key of the system (no 0x prefix).\n",
-                argv[0]);
+                "       %s --board-proof <token_hash_hex>\n"
+                "       %s --board-consistency <old_size> <new_size>\n"
+                "  N_hex, e_hex: RSA public key of the system (no 0x prefix).\n"
+                "  --board-proof: print and check the inclusion proof for a cast ballot.\n"
+                "  --board-consistency: prove the board at new_size extends the one at old_size.\n",
+                argv[0], argv[0], argv[0]);
         return 1;
     }
 
-    BN_CTX *bn_ctx = BN_CTX_new();
+    int rc = 1;
+    BN_CTX *bn_ctx = NULL;
+    BIGNUM *N = NULL;
+    BIGNUM *e = NULL;
+    RSAVerifyCtx *verify_ctx = NULL;
+    TokenSource tokens = { NULL, NULL, NULL, NULL };
+    BallotLog *ballots = NULL;
+    BoardWriter *board = NULL;
+
+    bn_ctx = BN_CTX_new();
     if (!bn_ctx) {
         fprintf(stderr, "BN_CTX_new failed\n");
-        return 1;
+        goto done;
     }
 
-    BIGNUM *N = NULL;
-    BIGNUM *e = NULL;
-
     if (!BN_hex2bn(&N, argv[1])) {
         fprintf(stderr, "Failed to parse N_hex.\n");
-        BN_CTX_free(bn_ctx);
-        return 1;
+        goto done;
     }
     if (!BN_hex2bn(&e, argv[2])) {
         fprintf(stderr, "Failed to parse e_hex.\n");
-        BN_free(N);
-        BN_CTX_free(bn_ctx);
-        return 1;
+        goto done;
+    }
+
+    verify_ctx = rsa_verify_ctx_new(N, e);
+    if (!verify_ctx) {
+        fprintf(stderr, "Failed to build signature verification context\n");
+        goto done;
+    }
+
+    if (!token_source_open(&tokens, N)) {
+        fprintf(stderr, "Failed to load registered tokens\n");
+        goto done;
     }
 
     if (RAND_status() != 1) {
         if (RAND_poll() != 1) {
             fprintf(stderr, "CSPRNG not properly seeded\n");
-            BN_free(N);
-            BN_free(e);
-            BN_CTX_free(bn_ctx);
-            return 1;
+            goto done;
         }
     }
 
-    u64 min_prime = (1ULL << 15);
-    u64 max_prime = (1ULL << 16) - 1;
-
-    u64 p = random_prime_in_range(min_prime, max_prime);
-    u64 q;
-    do {
-        q = random_prime_in_range(min_prime, max_prime);
-    } while (q == p);
+    // the log lock makes this the only voting process in the directory, so it is
+    // taken before anything else here, the Paillier key included, is written
+    BallotLogPolicy policy = { BALLOT_LOG_BATCH_RECORDS, BALLOT_LOG_BATCH_MS };
+    ballots = ballot_log_open(BALLOT_LOG_FILE, &policy);
+    if (!ballots) {
+        fprintf(stderr, "Failed to open ballot log %s\n", BALLOT_LOG_FILE);
+        goto done;
+    }
 
+    // the key must survive a restart, otherwise logged ballots could not be tallied
     Paillier_pub_key pub;
     Paillier_priv_key priv;
-    paillier_keygen(p, q, &pub, &priv);
+    int key_loaded = paillier_key_load(PAILLIER_KEY_FILE, &pub, &priv);
+    if (!key_loaded && ballot_log_count(ballots) > 0) {
+        fprintf(stderr, "%s holds ballots but %s was missing; move the log aside to start a new election\n",
+                BALLOT_LOG_FILE, PAILLIER_KEY_FILE);
+        goto done;
+    }
+    if (!key_loaded) {
+        u64 min_prime = (1ULL << 15);
+        u64 max_prime = (1ULL << 16) - 1;
+
+        u64 p = random_prime_in_range(min_prime, max_prime);
+        u64 q;
+        do {
+            q = random_prime_in_range(min_prime, max_prime);
+        } while (q == p);
+
+        paillier_keygen(p, q, &pub, &priv);
+        if (!paillier_key_save(PAILLIER_KEY_FILE, &pub, &priv)) {
+            fprintf(stderr, "Failed to save Paillier key\n");
+            goto done;
+        }
+    }
+    u64 key_id = paillier_key_id(&pub);
 
-    printf("=== Paillier key generated for this election ===\n");
+    printf("=== Paillier key %s for this election ===\n", key_loaded ? "loaded" : "generated");
     printf("n       = %llu\n", (unsigned long long)pub.n);
     printf("n^2     = %llu\n", (unsigned long long)pub.n_squared);
     printf("g       = %llu\n\n", (unsigned long long)pub.g);
@@ -206,29 +508,56 @@ int main(int argc, char *argv[]) {
     int c;
     while ((c = getchar()) != '\n' && c != EOF) { }
 
-    u64 *ciphertexts = malloc(MAX_VOTERS * sizeof(u64));
-    if (!ciphertexts) {
-        fprintf(stderr, "Memory allocation failed\n");
-        BN_free(N);
-        BN_free(e);
-        BN_CTX_free(bn_ctx);
-        return 1;
+
+    // resume from the latest checkpoint and replay only the log tail after it
+    TallyReplay resume = { pub.n_squared, 1 % pub.n_squared, 0, 0 };
+    TallyCheckpoint cp;
+    if (tally_checkpoint_read(TALLY_CHECKPOINT_FILE, &cp)) {
+        if (cp.key_id == key_id && cp.last_seq <= ballot_log_count(ballots)) {
+            resume.c_tally = cp.c_tally;
+            resume.valid_votes = cp.valid_votes;
+            resume.last_seq = cp.last_seq;
+        } else {
+            fprintf(stderr, "Tally checkpoint does not match this key and log, replaying the whole log\n");
+        }
+    }
+    unsigned long long from_checkpoint = resume.valid_votes;
+    if (!ballot_log_replay(BALLOT_LOG_FILE, resume.last_seq, replay_ballot, &resume)) {
+        fprintf(stderr, "Failed to replay %s\n", BALLOT_LOG_FILE);
+        goto done;
     }
+    if (resume.valid_votes > 0) {
+        printf("Resumed %llu ballots (%llu from checkpoint, %llu replayed from %s)\n",
+               resume.valid_votes, from_checkpoint, resume.valid_votes - from_checkpoint, BALLOT_LOG_FILE);
+    }
+    uint64_t last_seq = resume.last_seq;
 
-    u64 C_tally = 1 % pub.n_squared;
-    unsigned long long valid_votes = 0;
+    board = board_writer_open(BOARD_FILE);
+    if (!board) {
+        fprintf(stderr, "Failed to open bulletin board %s\n", BOARD_FILE);
+        goto done;
+    }
+    if (board_writer_size(board) > ballot_log_count(ballots)) {
+        fprintf(stderr, "%s is ahead of %s; it belongs to another election\n", BOARD_FILE, BALLOT_LOG_FILE);
+        goto done;
+    }
+    if (!ballot_log_replay(BALLOT_LOG_FILE, board_writer_size(board), board_catch_up_one, board)) {
+        fprintf(stderr, "Failed to bring %s up to date\n", BOARD_FILE);
+        goto done;
+    }
+
+    u64 C_tally = resume.c_tally;
+    unsigned long long valid_votes = resume.valid_votes;
+    unsigned long long since_checkpoint = 0;
+    time_t last_checkpoint = time(NULL);
 
     time_t start_time = time(NULL);
     if (start_time == (time_t)-1) {
         fprintf(stderr, "time() failed\n");
-        free(ciphertexts);
-        BN_free(N);
-        BN_free(e);
-        BN_CTX_free(bn_ctx);
-        return 1;
+        goto done;
     }
 
-    while (valid_votes < MAX_VOTERS) {
+    while (1) {
         time_t now = time(NULL);
         if (now == (time_t)-1) {
             fprintf(stderr, "time() failed\n");
@@ -243,7 +572,6 @@ int main(int argc, char *argv[]) {
         printf("\n=== Voter %llu ===\n", (unsigned long long)(valid_votes + 1));
 
         char buf[4096];
-        char token_hex[2 * SHA256_DIGEST_LENGTH + 1];
 
         unsigned char nonce[NONCE_BYTES];
         unsigned char token_hash[SHA256_DIGEST_LENGTH];
@@ -270,12 +598,7 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
-        for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-            sprintf(&token_hex[2 * i], "%02x", token_hash[i]);
-        }
-        token_hex[2 * SHA256_DIGEST_LENGTH] = '\0';
-
-        if (!token_exists(token_hex)) {
+        if (!token_available(&tokens, token_hash)) {
             fprintf(stderr, "Token not registered or already used, vote rejected\n");
             continue;
         }
@@ -307,7 +630,7 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
-        if (!verify_signature(m, s, N, e, bn_ctx)) {
+        if (!rsa_verify_ctx_check(verify_ctx, m, s)) {
             fprintf(stderr, "Invalid token/signature, vote rejected\n");
             BN_free(m);
             BN_free(s);
@@ -332,24 +655,72 @@ int main(int argc, char *argv[]) {
 
         while ((c = getchar()) != '\n' && c != EOF) { }
 
+        // spend before counting so a token raced by another voter is not tallied twice
+        int spent = token_spend(&tokens, token_hash);
+        if (spent == 0) {
+            fprintf(stderr, "Token already used, vote rejected\n");
+            continue;
+        }
+        if (spent < 0) {
+            // the token is not durably spent, so counting it would let it vote again
+            fprintf(stderr, "Failed to record spent token, vote rejected\n");
+            continue;
+        }
+
         u64 m_vote = (u64)vote;
         u64 r = random_coprime(pub.n);
         u64 ciph = paillier_encrypt(m_vote, r, &pub);
-        ciphertexts[valid_votes] = ciph;
 
+        // token_spend returned 1 only once the spend was on disk (the store bitmap
+        // msync'd or the spent log synced), so the voter waits for this ballot's
+        // group commit too; otherwise a crash in between burns the token and loses the ballot
+        if (!ballot_log_append(ballots, token_hash, ciph, &last_seq)) {
+            fprintf(stderr, "Failed to log ballot, vote rejected\n");
+            continue;
+        }
+        int durable = ballot_log_wait_durable(ballots, last_seq);
+
+        // once posting fails the rest of the session waits for the catch-up at the next start
+        if (!board_writer_broken(board)) {
+            BoardEntry entry = { last_seq, {0}, ciph };
+            memcpy(entry.token_hash, token_hash, BOARD_TOKEN_BYTES);
+            if (!board_writer_append(board, &entry)) {
+                fprintf(stderr, "Warning: bulletin board stopped taking ballots, they are posted from %s at the next start\n",
+                        BALLOT_LOG_FILE);
+            }
+        }
+
+        // the record is in the log either way, so the running tally keeps matching it
         C_tally = mod_mul(C_tally, ciph, pub.n_squared);
         valid_votes++;
 
-        if (!remove_token(token_hex)) {
-            fprintf(stderr, "Warning: failed to erase token from tokens.txt\n");
+        if (!durable) {
+            fprintf(stderr, "Ballot log could not be synced, stopping the vote\n");
+            break;
+        }
+
+        if (++since_checkpoint >= TALLY_CHECKPOINT_BALLOTS ||
+            difftime(time(NULL), last_checkpoint) >= TALLY_CHECKPOINT_SECONDS) {
+            if (!write_tally_checkpoint(ballots, key_id, C_tally, valid_votes, last_seq)) {
+                fprintf(stderr, "Warning: tally checkpoint failed\n");
+            }
+            since_checkpoint = 0;
+            last_checkpoint = time(NULL);
         }
     }
 
-    printf("\n=== Published encrypted votes (ciphertexts) ===\n");
-    for (unsigned long long i = 0; i < valid_votes; i++) {
-        printf("Voter %llu: c = %llu\n",
-               (unsigned long long)(i + 1),
-               (unsigned long long)ciphertexts[i]);
+    if (!write_tally_checkpoint(ballots, key_id, C_tally, valid_votes, last_seq)) {
+        fprintf(stderr, "Warning: ballot log or tally checkpoint is not fully on disk\n");
+    }
+
+    u64 archived_tally;
+    unsigned long long archived_votes;
+    if (!publish_ballots(&pub, &archived_tally, &archived_votes)) goto done;
+    if (archived_tally != C_tally || archived_votes != valid_votes) {
+        fprintf(stderr, "Warning: running tally (%llu ballots) disagrees with %s (%llu ballots), tallying the archive\n",
+                valid_votes, BALLOT_LOG_FILE, archived_votes);
+        C_tally = archived_tally;
+        valid_votes = archived_votes;
     }
 
     u64 total_yes = paillier_decrypt(C_tally, &pub, &priv);
@@ -364,11 +735,21 @@ int main(int argc, char *argv[]) {
     printf("Total YES votes: %llu\n", (unsigned long long)total_yes);
     printf("Total  NO  votes: %llu\n", total_no);
 
-    free(ciphertexts);
+    if (!board_writer_sync(board) || !publish_board_root(board)) {
+        fprintf(stderr, "Warning: bulletin board root was not published durably\n");
+    }
+
+    rc = 0;
+
+done:
+    board_writer_close(board);
+    ballot_log_close(ballots);
+    token_source_close(&tokens);
+    rsa_verify_ctx_free(verify_ctx);
     BN_free(N);
     BN_free(e);
     BN_CTX_free(bn_ctx);
 
-    return 0;
+    return rc;
 }
 
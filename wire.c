@@ -0,0 +1,297 @@
+#define _GNU_SOURCE  // struct ucred
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <openssl/bn.h>
+#include "wire.h"
+
+static int write_all(int fd, const unsigned char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+static int read_all(int fd, unsigned char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = read(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        if (n == 0) return 0;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+static void put_header(unsigned char *frame, uint8_t type, uint32_t len) {
+    frame[0] = (unsigned char)(len >> 24);
+    frame[1] = (unsigned char)(len >> 16);
+    frame[2] = (unsigned char)(len >> 8);
+    frame[3] = (unsigned char)len;
+    frame[4] = type;
+}
+
+static uint32_t get_length(const unsigned char *header) {
+    return ((uint32_t)header[0] << 24) | ((uint32_t)header[1] << 16) |
+           ((uint32_t)header[2] << 8) | (uint32_t)header[3];
+}
+
+int wire_send(int fd, uint8_t type, const void *payload, uint32_t len) {
+    if (len > WIRE_MAX_PAYLOAD) return 0;
+
+    unsigned char frame[WIRE_HEADER_SIZE + WIRE_MAX_PAYLOAD];
+    put_header(frame, type, len);
+    if (len > 0) memcpy(frame + WIRE_HEADER_SIZE, payload, len);
+
+    return write_all(fd, frame, WIRE_HEADER_SIZE + len);
+}
+
+int wire_recv(int fd, uint8_t *type_out, void *payload, uint32_t cap, uint32_t *len_out) {
+    unsigned char header[WIRE_HEADER_SIZE];
+    if (!read_all(fd, header, sizeof(header))) return 0;
+
+    uint32_t len = get_length(header);
+    if (len > cap || len > WIRE_MAX_PAYLOAD) return 0;
+    if (len > 0 && !read_all(fd, payload, len)) return 0;
+
+    *type_out = header[4];
+    *len_out = len;
+    return 1;
+}
+
+// payload builders shared by the blocking and the buffered senders; -1 if it does not fit
+static int status_payload(unsigned char buf[256], uint8_t status, const char *msg) {
+    size_t msg_len = msg ? strlen(msg) : 0;
+    if (msg_len > 255) msg_len = 255;
+
+    buf[0] = status;
+    if (msg_len > 0) memcpy(buf + 1, msg, msg_len);
+    return (int)(1 + msg_len);
+}
+
+static int bn_payload(unsigned char buf[WIRE_MAX_PAYLOAD], const BIGNUM *bn) {
+    int len = BN_num_bytes(bn);
+    if (len > WIRE_MAX_PAYLOAD) return -1;
+    BN_bn2bin(bn, buf);
+    return len;
+}
+
+static int pubkey_payload(unsigned char buf[WIRE_MAX_PAYLOAD], const BIGNUM *N, const BIGNUM *e) {
+    int n_len = BN_num_bytes(N);
+    int e_len = BN_num_bytes(e);
+    if (4 + n_len + e_len > WIRE_MAX_PAYLOAD) return -1;
+
+    buf[0] = (unsigned char)(n_len >> 8);
+    buf[1] = (unsigned char)n_len;
+    BN_bn2bin(N, buf + 2);
+    buf[2 + n_len] = (unsigned char)(e_len >> 8);
+    buf[3 + n_len] = (unsigned char)e_len;
+    BN_bn2bin(e, buf + 4 + n_len);
+    return 4 + n_len + e_len;
+}
+
+int wire_send_status(int fd, uint8_t status, const char *msg) {
+    unsigned char buf[256];
+    return wire_send(fd, WIRE_MSG_STATUS, buf, (uint32_t)status_payload(buf, status, msg));
+}
+
+int wire_send_bn(int fd, uint8_t type, const BIGNUM *bn) {
+    unsigned char buf[WIRE_MAX_PAYLOAD];
+    int len = bn_payload(buf, bn);
+    return len >= 0 && wire_send(fd, type, buf, (uint32_t)len);
+}
+
+int wire_send_pubkey(int fd, const BIGNUM *N, const BIGNUM *e) {
+    unsigned char buf[WIRE_MAX_PAYLOAD];
+    int len = pubkey_payload(buf, N, e);
+    return len >= 0 && wire_send(fd, WIRE_MSG_PUBKEY, buf, (uint32_t)len);
+}
+
+void wire_conn_init(WireConn *c, int fd) {
+    memset(c, 0, sizeof(*c));
+    c->fd = fd;
+}
+
+void wire_conn_free(WireConn *c) {
+    free(c->out);
+    c->out = NULL;
+    c->out_len = c->out_cap = c->out_sent = 0;
+}
+
+int wire_conn_fill(WireConn *c) {
+    while (c->in_len < sizeof(c->in)) {
+        ssize_t n = read(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        if (n == 0) return 0;
+        c->in_len += (size_t)n;
+    }
+    return 1;
+}
+
+int wire_conn_frame(const WireConn *c, uint8_t *type_out, const unsigned char **payload, uint32_t *len_out) {
+    if (c->in_len < WIRE_HEADER_SIZE) return 0;
+    uint32_t len = get_length(c->in);
+    if (len > WIRE_MAX_PAYLOAD) return -1;
+    if (c->in_len < WIRE_HEADER_SIZE + len) return 0;
+
+    *type_out = c->in[4];
+    *payload = c->in + WIRE_HEADER_SIZE;
+    *len_out = len;
+    return 1;
+}
+
+void wire_conn_consume(WireConn *c) {
+    size_t used = WIRE_HEADER_SIZE + get_length(c->in);
+    memmove(c->in, c->in + used, c->in_len - used);
+    c->in_len -= used;
+}
+
+int wire_conn_queue(WireConn *c, uint8_t type, const void *payload, uint32_t len) {
+    if (len > WIRE_MAX_PAYLOAD) return 0;
+
+    size_t need = c->out_len + WIRE_HEADER_SIZE + len;
+    if (need > c->out_cap) {
+        size_t cap = c->out_cap ? c->out_cap * 2 : 512;
+        while (cap < need) cap *= 2;
+        unsigned char *out = realloc(c->out, cap);
+        if (!out) return 0;
+        c->out = out;
+        c->out_cap = cap;
+    }
+
+    put_header(c->out + c->out_len, type, len);
+    if (len > 0) memcpy(c->out + c->out_len + WIRE_HEADER_SIZE, payload, len);
+    c->out_len = need;
+    return 1;
+}
+
+int wire_conn_queue_status(WireConn *c, uint8_t status, const char *msg) {
+    unsigned char buf[256];
+    return wire_conn_queue(c, WIRE_MSG_STATUS, buf, (uint32_t)status_payload(buf, status, msg));
+}
+
+int wire_conn_queue_bn(WireConn *c, uint8_t type, const BIGNUM *bn) {
+    unsigned char buf[WIRE_MAX_PAYLOAD];
+    int len = bn_payload(buf, bn);
+    return len >= 0 && wire_conn_queue(c, type, buf, (uint32_t)len);
+}
+
+int wire_conn_queue_pubkey(WireConn *c, const BIGNUM *N, const BIGNUM *e) {
+    unsigned char buf[WIRE_MAX_PAYLOAD];
+    int len = pubkey_payload(buf, N, e);
+    return len >= 0 && wire_conn_queue(c, WIRE_MSG_PUBKEY, buf, (uint32_t)len);
+}
+
+int wire_conn_pending(const WireConn *c) {
+    return c->out_sent < c->out_len;
+}
+
+int wire_conn_flush(WireConn *c) {
+    while (c->out_sent < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_sent, c->out_len - c->out_sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        c->out_sent += (size_t)n;
+    }
+    c->out_len = c->out_sent = 0;
+    return 1;
+}
+
+int wire_parse_pubkey(const unsigned char *payload, uint32_t len, BIGNUM **N_out, BIGNUM **e_out) {
+    if (len < 2) return 0;
+    uint32_t n_len = ((uint32_t)payload[0] << 8) | payload[1];
+    if (2 + n_len + 2 > len) return 0;
+    uint32_t e_len = ((uint32_t)payload[2 + n_len] << 8) | payload[3 + n_len];
+    if (4 + n_len + e_len != len) return 0;
+
+    BIGNUM *N = BN_bin2bn(payload + 2, (int)n_len, NULL);
+    BIGNUM *e = BN_bin2bn(payload + 4 + n_len, (int)e_len, NULL);
+    if (!N || !e) {
+        BN_free(N);
+        BN_free(e);
+        return 0;
+    }
+
+    *N_out = N;
+    *e_out = e;
+    return 1;
+}
+
+static int fill_unix_addr(struct sockaddr_un *addr, const char *path) {
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return 0;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, path);
+    return 1;
+}
+
+int wire_listen_unix(const char *path) {
+    struct sockaddr_un addr;
+    if (!fill_unix_addr(&addr, path)) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, SOMAXCONN) != 0) {
+        perror("listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int wire_peer_uid(int fd, uint32_t *uid_out) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0 || len != sizeof(cred)) return 0;
+    *uid_out = (uint32_t)cred.uid;
+    return 1;
+}
+
+int wire_connect_unix(const char *path) {
+    struct sockaddr_un addr;
+    if (!fill_unix_addr(&addr, path)) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("connect");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
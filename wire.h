@@ -0,0 +1,69 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stdint.h>
+#include <openssl/bn.h>
+
+// frame: u32 payload length (big-endian) | u8 message type | payload
+#define WIRE_HEADER_SIZE 5
+#define WIRE_MAX_PAYLOAD 4096
+
+enum {
+    WIRE_MSG_PUBKEY = 1,    // server -> client: u16 len | N | u16 len | e
+    WIRE_MSG_AUTH_ID,       // client -> server: student ID
+    WIRE_MSG_AUTH_CODE,     // client -> server: verification code
+    WIRE_MSG_STATUS,        // server -> client: u8 status | message text
+    WIRE_MSG_BLIND_REQ,     // client -> server: blinded token m'
+    WIRE_MSG_BLIND_SIG,     // server -> client: blinded signature s'
+    WIRE_MSG_TOKEN_COMMIT,  // client -> server: 32-byte token hash to register
+};
+
+enum {
+    WIRE_STATUS_OK = 0,
+    WIRE_STATUS_FAIL = 1,
+    WIRE_STATUS_ALREADY_ISSUED = 2,
+};
+
+int wire_send(int fd, uint8_t type, const void *payload, uint32_t len);
+// reads one whole frame; returns 1 on success, 0 on EOF, error or oversized frame
+int wire_recv(int fd, uint8_t *type_out, void *payload, uint32_t cap, uint32_t *len_out);
+
+int wire_send_status(int fd, uint8_t status, const char *msg);
+int wire_send_bn(int fd, uint8_t type, const BIGNUM *bn);
+int wire_send_pubkey(int fd, const BIGNUM *N, const BIGNUM *e);
+int wire_parse_pubkey(const unsigned char *payload, uint32_t len, BIGNUM **N_out, BIGNUM **e_out);
+
+// buffered end of a non-blocking connection, for servers that multiplex many
+// sessions on one thread: frames are parsed out of the input buffer once they
+// are complete, and replies queue up until the socket can take them
+typedef struct {
+    int fd;
+    unsigned char in[WIRE_HEADER_SIZE + WIRE_MAX_PAYLOAD];
+    size_t in_len;
+    unsigned char *out;
+    size_t out_len, out_cap, out_sent;
+} WireConn;
+
+void wire_conn_init(WireConn *c, int fd);
+// frees the output queue; the descriptor is left open
+void wire_conn_free(WireConn *c);
+// reads whatever is available; 0 on EOF or error
+int wire_conn_fill(WireConn *c);
+// 1 if a whole frame is buffered (payload stays valid until wire_conn_consume),
+// 0 if more bytes are needed, -1 if the peer announced an oversized frame
+int wire_conn_frame(const WireConn *c, uint8_t *type_out, const unsigned char **payload, uint32_t *len_out);
+void wire_conn_consume(WireConn *c);
+int wire_conn_queue(WireConn *c, uint8_t type, const void *payload, uint32_t len);
+int wire_conn_queue_status(WireConn *c, uint8_t status, const char *msg);
+int wire_conn_queue_bn(WireConn *c, uint8_t type, const BIGNUM *bn);
+int wire_conn_queue_pubkey(WireConn *c, const BIGNUM *N, const BIGNUM *e);
+int wire_conn_pending(const WireConn *c);
+// writes as much as the socket takes; 1 once the queue is empty, 0 if bytes remain, -1 on error
+int wire_conn_flush(WireConn *c);
+
+int wire_listen_unix(const char *path);
+// user ID of the process on the other end of a Unix socket; 0 if unavailable
+int wire_peer_uid(int fd, uint32_t *uid_out);
+int wire_connect_unix(const char *path);
+
+#endif